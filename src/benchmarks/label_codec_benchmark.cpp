@@ -0,0 +1,119 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <lucrezio_semantic_perception/object_detector.h>
+#include <lucrezio_semantic_perception/synthetic_scene.h>
+#include <lucrezio_semantic_perception/label_codec.h>
+
+using namespace lucrezio_semantic_perception;
+
+//encodes the label images the detector computes on synthetic sequences, where some
+//models drift a few millimeters per frame, and reports the compression ratio against
+//raw bgr8 and the encode and decode times. Every frame must decode to the original
+//image (the exit code reports it).
+
+struct Configuration{
+  const char* name;
+  int keyframe_interval;
+};
+
+struct Result{
+  Result():encode_time(0),decode_time(0),num_bytes(0),num_keyframes(0),num_deltas(0),num_raw(0),num_failures(0){}
+  double encode_time;
+  double decode_time;
+  size_t num_bytes;
+  int num_keyframes;
+  int num_deltas;
+  int num_raw;
+  int num_failures;
+};
+
+int main(int argc, char** argv){
+  const int num_scenes = argc > 1 ? std::atoi(argv[1]) : 5;
+  const int num_frames = argc > 2 ? std::atoi(argv[2]) : 30;
+
+  const Configuration configurations[] = {
+    {"keyframes only", 1},
+    {"delta, keyframe every 30", 30},
+    {"delta, keyframe every 300", 300}
+  };
+  const int num_configurations = sizeof(configurations)/sizeof(Configuration);
+
+  //label images of every frame
+  std::vector<RGBImage> frames;
+  SyntheticScene scene;
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  for(int s=0; s<num_scenes; ++s){
+    scene.generate(s);
+    detector.setK(scene.K());
+    detector.setImages(scene.rgbImage(),scene.depthImage());
+    detector.setCameraTransforms(scene.rgbdCameraTransform(),scene.logicalCameraTransform());
+    for(int f=0; f<num_frames; ++f){
+      ModelVector models = scene.models();
+      for(size_t i=0; i<models.size(); i+=3)
+        models[i].pose().translation().x() += 0.003f*f;
+      detector.setModels(models);
+      detector.compute();
+      frames.push_back(detector.labelImage().clone());
+    }
+  }
+  const size_t raw_bytes = frames.size()*frames[0].total()*3;
+
+  std::vector<Result> results(num_configurations);
+  std::vector<unsigned char> packet;
+  for(int i=0; i<num_configurations; ++i){
+    LabelImageEncoder encoder;
+    LabelImageDecoder decoder;
+    encoder.setKeyframeInterval(configurations[i].keyframe_interval);
+    Result &result = results[i];
+    for(size_t f=0; f<frames.size(); ++f){
+      //sequences don't continue each other
+      if(f % num_frames == 0)
+        encoder.reset();
+
+      double time = (double)cv::getTickCount();
+      encoder.encode(frames[f],packet);
+      result.encode_time += ((double)cv::getTickCount() - time)/cv::getTickFrequency();
+      result.num_bytes += packet.size();
+      result.num_keyframes += encoder.lastMode() == LabelImageEncoder::KeyframeMode;
+      result.num_deltas += encoder.lastMode() == LabelImageEncoder::DeltaMode;
+      result.num_raw += encoder.lastMode() == LabelImageEncoder::RawMode;
+
+      time = (double)cv::getTickCount();
+      const bool decoded = decoder.decode(&packet[0],packet.size());
+      result.decode_time += ((double)cv::getTickCount() - time)/cv::getTickFrequency();
+
+      bool equal = decoded;
+      for(int r=0; equal && r<frames[f].rows; ++r)
+        for(int c=0; equal && c<frames[f].cols; ++c)
+          equal = (decoder.image()(r,c) == frames[f](r,c));
+      if(!equal)
+        ++result.num_failures;
+    }
+  }
+
+  bool ok = true;
+  const int num_images = frames.size();
+  printf("%d frames, raw %.1f KB/frame\n",num_images,raw_bytes/1024.0/num_images);
+  printf("%-28s %10s %8s %10s %10s %18s %9s\n","configuration","KB/frame","ratio","encode ms","decode ms","key/delta/raw","failures");
+  for(int i=0; i<num_configurations; ++i){
+    const Result &result = results[i];
+    ok = ok && !result.num_failures;
+    char modes[32];
+    std::snprintf(modes,sizeof(modes),"%d/%d/%d",result.num_keyframes,result.num_deltas,result.num_raw);
+    printf("%-28s %10.2f %8.1f %10.3f %10.3f %18s %9d%s\n",
+           configurations[i].name,
+           result.num_bytes/1024.0/num_images,
+           (double)raw_bytes/result.num_bytes,
+           1000*result.encode_time/num_images,
+           1000*result.decode_time/num_images,
+           modes,
+           result.num_failures,
+           result.num_failures ? "  FAILED" : "");
+  }
+
+  return ok ? 0 : 1;
+}
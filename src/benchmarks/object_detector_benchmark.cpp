@@ -0,0 +1,158 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include <lucrezio_semantic_perception/object_detector.h>
+#include <lucrezio_semantic_perception/synthetic_scene.h>
+
+using namespace lucrezio_semantic_perception;
+
+//runs every detector configuration on deterministic synthetic scenes and compares
+//the masks with the expected labels. Full resolution configurations must match
+//exactly (the exit code reports it), coarser ones report their quality.
+//Compact point, fixed size, incremental and bounded memory configurations must also
+//match their counterpart exactly.
+
+struct Configuration{
+  const char* name;
+  ObjectDetector::Engine engine;
+  int pyramid_level;
+  bool refine_boundaries;
+  ObjectDetector::PointFormat point_format;
+  //runs full resolution back-projection on the compile-time sized core
+  bool fixed_size;
+  //the previous frame of the sequence, in which half of the models are elsewhere,
+  //is computed untimed before the timed one
+  bool incremental;
+  //0 for the default memory use, otherwise bounded memory with this many pixels per detection
+  int max_detection_pixels;
+  bool exact;
+  //index of the configuration this one must reproduce exactly, -1 if none
+  int reference;
+};
+
+struct Result{
+  Result():time(0),memory(0),num_mismatches(0),num_reference_mismatches(0),intersection(0),union_(0){}
+  double time;
+  size_t memory;
+  long num_mismatches;
+  long num_reference_mismatches;
+  long intersection;
+  long union_;
+};
+
+int main(int argc, char** argv){
+  const int num_scenes = argc > 1 ? std::atoi(argv[1]) : 10;
+  const unsigned int first_seed = argc > 2 ? std::atoi(argv[2]) : 0;
+
+  const ObjectDetector::PointFormat float3 = ObjectDetector::Float3PointFormat;
+  const ObjectDetector::PointFormat compact = ObjectDetector::CompactPointFormat;
+  const Configuration configurations[] = {
+    {"back-projection",          ObjectDetector::BackProjectionEngine, 0, true,  float3, false, false, 0, true,  -1},
+    {"rasterization",            ObjectDetector::RasterizationEngine,  0, true,  float3, false, false, 0, true,  -1},
+    {"back-projection 1/2",      ObjectDetector::BackProjectionEngine, 1, false, float3, false, false, 0, false, -1},
+    {"back-projection 1/2 refined", ObjectDetector::BackProjectionEngine, 1, true, float3, false, false, 0, false, -1},
+    {"back-projection 1/4",      ObjectDetector::BackProjectionEngine, 2, false, float3, false, false, 0, false, -1},
+    {"back-projection 1/4 refined", ObjectDetector::BackProjectionEngine, 2, true, float3, false, false, 0, false, -1},
+    {"rasterization 1/2 refined", ObjectDetector::RasterizationEngine, 1, true,  float3, false, false, 0, false, -1},
+    {"back-projection compact",  ObjectDetector::BackProjectionEngine, 0, true,  compact, false, false, 0, true,  0},
+    {"rasterization compact",    ObjectDetector::RasterizationEngine,  0, true,  compact, false, false, 0, true,  1},
+    {"back-projection 1/2 compact", ObjectDetector::BackProjectionEngine, 1, false, compact, false, false, 0, false, 2},
+    {"back-projection 1/2 refined compact", ObjectDetector::BackProjectionEngine, 1, true, compact, false, false, 0, false, 3},
+    {"back-projection fixed size", ObjectDetector::BackProjectionEngine, 0, true, float3, true, false, 0, true, 0},
+    {"back-projection compact fixed size", ObjectDetector::BackProjectionEngine, 0, true, compact, true, false, 0, true, 0},
+    {"back-projection incremental", ObjectDetector::BackProjectionEngine, 0, true, float3, false, true, 0, true, 0},
+    {"back-projection compact incremental", ObjectDetector::BackProjectionEngine, 0, true, compact, false, true, 0, true, 0},
+    {"back-projection bounded", ObjectDetector::BackProjectionEngine, 0, true, float3, false, false, 1000, true, 0},
+    {"rasterization compact bounded", ObjectDetector::RasterizationEngine, 0, true, compact, false, false, 1000, true, 1},
+    {"back-projection 1/2 refined bounded", ObjectDetector::BackProjectionEngine, 1, true, float3, false, false, 1000, false, 3},
+    {"back-projection incremental bounded", ObjectDetector::BackProjectionEngine, 0, true, float3, false, true, 1000, true, 0}
+  };
+  const int num_configurations = sizeof(configurations)/sizeof(Configuration);
+  std::vector<Result> results(num_configurations);
+
+  //every configuration is timed on the second frame of each sequence, whose noise
+  //and holes are drawn again like a real sensor's
+  SyntheticScene::Parameters parameters;
+  parameters.noise_per_frame = true;
+  SyntheticScene previous_scene(parameters), scene(parameters);
+  std::vector<IntImage> labels(num_configurations);
+  for(int s=0; s<num_scenes; ++s){
+    previous_scene.generate(first_seed+s,0);
+    scene.generate(first_seed+s,1);
+    const IntImage &expected = scene.expectedLabels();
+
+    for(int i=0; i<num_configurations; ++i){
+      const Configuration &configuration = configurations[i];
+      ObjectDetector detector;
+      detector.setVerbose(false);
+      detector.setEngine(configuration.engine);
+      detector.setPyramidLevel(configuration.pyramid_level);
+      detector.setRefineBoundaries(configuration.refine_boundaries);
+      detector.setPointFormat(configuration.point_format);
+      if(configuration.fixed_size)
+        detector.setSensorResolution(expected.rows,expected.cols);
+      detector.setIncremental(configuration.incremental);
+      detector.setBoundedMemory(configuration.max_detection_pixels > 0);
+      detector.setMaxDetectionPixels(configuration.max_detection_pixels);
+      detector.setK(scene.K());
+
+      if(configuration.incremental){
+        detector.setImages(previous_scene.rgbImage(),previous_scene.depthImage());
+        detector.setCameraTransforms(previous_scene.rgbdCameraTransform(),previous_scene.logicalCameraTransform());
+        detector.setModels(previous_scene.models());
+        detector.compute();
+      }
+
+      double time = (double)cv::getTickCount();
+      detector.setImages(scene.rgbImage(),scene.depthImage());
+      detector.setCameraTransforms(scene.rgbdCameraTransform(),scene.logicalCameraTransform());
+      detector.setModels(scene.models());
+      detector.compute();
+      results[i].time += ((double)cv::getTickCount() - time)/cv::getTickFrequency();
+      results[i].memory = std::max(results[i].memory,detector.memoryUsage());
+
+      //detections are indexed like the models
+      IntImage &configuration_labels = labels[i];
+      configuration_labels.create(expected.rows,expected.cols);
+      configuration_labels = -1;
+      const DetectionVector &detections = detector.detections();
+      for(int j=0; j<(int)detections.size(); ++j)
+        detections[j].forEachPixel([&configuration_labels,j](int r, int c){configuration_labels(r,c) = j;});
+
+      for(int r=0; r<expected.rows; ++r)
+        for(int c=0; c<expected.cols; ++c){
+          const int a = configuration_labels(r,c);
+          const int b = expected(r,c);
+          if(configuration.reference >= 0 && a != labels[configuration.reference](r,c))
+            ++results[i].num_reference_mismatches;
+          if(a != b)
+            ++results[i].num_mismatches;
+          if(a >= 0 && a == b)
+            ++results[i].intersection;
+          if(a >= 0 || b >= 0)
+            ++results[i].union_;
+        }
+    }
+  }
+
+  bool ok = true;
+  printf("%-38s %10s %10s %12s %8s\n","configuration","ms/frame","peak KB","mismatches","IoU");
+  for(int i=0; i<num_configurations; ++i){
+    const Configuration &configuration = configurations[i];
+    const Result &result = results[i];
+    const bool failed = (configuration.exact && result.num_mismatches) || result.num_reference_mismatches;
+    ok = ok && !failed;
+    printf("%-38s %10.3f %10lu %12ld %8.4f%s\n",
+           configuration.name,
+           1000*result.time/num_scenes,
+           (unsigned long)(result.memory/1024),
+           result.num_mismatches,
+           result.union_ ? (double)result.intersection/result.union_ : 1.0,
+           failed ? "  FAILED" : "");
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include <opencv2/core.hpp>
+
+#include <lucrezio_semantic_perception/scene_io.h>
+
+using namespace lucrezio_semantic_perception;
+
+//writes num_scenes random scene files in a directory, then times parsing all of them back
+
+int main(int argc, char** argv){
+  if(argc < 2){
+    std::cerr << "usage: scene_parser_benchmark <directory> [num_scenes=100000] [num_models=20]" << std::endl;
+    return 1;
+  }
+  const std::string directory = argv[1];
+  const int num_scenes = argc > 2 ? std::atoi(argv[2]) : 100000;
+  const int num_models = argc > 3 ? std::atoi(argv[3]) : 20;
+  mkdir(directory.c_str(),0755);
+
+  const char* types[] = {"table","tomato","salt","milk"};
+  std::srand(0);
+
+  //generate
+  std::vector<std::string> filenames(num_scenes);
+  Eigen::Isometry3f rgbd_camera_transform,logical_camera_transform;
+  ModelVector models(num_models);
+  size_t num_bytes = 0;
+  for(int i=0; i<num_scenes; ++i){
+    rgbd_camera_transform = Eigen::Translation3f(Eigen::Vector3f::Random())*Eigen::Quaternionf(Eigen::Vector4f::Random()).normalized();
+    logical_camera_transform = Eigen::Translation3f(Eigen::Vector3f::Random())*Eigen::Quaternionf(Eigen::Vector4f::Random()).normalized();
+    for(int j=0; j<num_models; ++j){
+      char type[32];
+      std::snprintf(type,sizeof(type),"%s_%d",types[j%4],j);
+      Eigen::Isometry3f pose(Eigen::Translation3f(5*Eigen::Vector3f::Random())*Eigen::Quaternionf(Eigen::Vector4f::Random()).normalized());
+      Eigen::Vector3f extent = Eigen::Vector3f::Random().cwiseAbs();
+      models[j] = Model(type,pose,-extent,extent);
+    }
+
+    char filename[64];
+    std::snprintf(filename,sizeof(filename),"/scene_%06d.txt",i);
+    filenames[i] = directory+filename;
+    if(!writeScene(filenames[i],rgbd_camera_transform,logical_camera_transform,models)){
+      std::cerr << "cannot write " << filenames[i] << std::endl;
+      return 1;
+    }
+    struct stat info;
+    if(!stat(filenames[i].c_str(),&info))
+      num_bytes += info.st_size;
+  }
+
+  //parse
+  SceneParser parser;
+  ModelVector parsed_models;
+  Eigen::Isometry3f parsed_rgbd_camera_transform,parsed_logical_camera_transform;
+  int num_failures = 0;
+  size_t num_parsed_models = 0;
+  double time = (double)cv::getTickCount();
+  for(int i=0; i<num_scenes; ++i){
+    if(!parser.read(filenames[i],parsed_rgbd_camera_transform,parsed_logical_camera_transform,parsed_models)){
+      std::cerr << parser.error() << std::endl;
+      ++num_failures;
+      continue;
+    }
+    num_parsed_models += parsed_models.size();
+  }
+  time = ((double)cv::getTickCount() - time)/cv::getTickFrequency();
+
+  //the last scene should read back exactly
+  const Model &last = models.back();
+  const Model &parsed_last = parsed_models.back();
+  const bool round_trip = (last.type() == parsed_last.type() &&
+                           last.pose().matrix() == parsed_last.pose().matrix() &&
+                           last.min() == parsed_last.min() &&
+                           last.max() == parsed_last.max() &&
+                           rgbd_camera_transform.matrix() == parsed_rgbd_camera_transform.matrix());
+
+  printf("Parsed %d scenes (%lu models, %.1f MB) in %f s: %.0f scenes/s, %.1f MB/s\n",
+         num_scenes-num_failures,(unsigned long)num_parsed_models,num_bytes/1e6,
+         time,num_scenes/time,num_bytes/1e6/time);
+  printf("Failures: %d, round trip: %s\n",num_failures,round_trip ? "exact" : "MISMATCH");
+
+  return num_failures || !round_trip;
+}
@@ -0,0 +1,50 @@
+#include "label_publisher.h"
+
+#include <sensor_msgs/image_encodings.h>
+
+#include <stdexcept>
+
+namespace lucrezio_semantic_perception{
+
+  void LabelPublisher::publish(const sensor_msgs::Image &message, const PublishFn &publish_fn) const{
+    //the encoding helpers throw on encodings they don't know, those are rejected too
+    bool supported = false;
+    try{
+      supported = (sensor_msgs::image_encodings::numChannels(message.encoding) == 3 &&
+                   sensor_msgs::image_encodings::bitDepth(message.encoding) == 8);
+    } catch(const std::runtime_error &){
+      supported = false;
+    }
+    if(!supported){
+      ROS_ERROR_THROTTLE(1,"label transport only supports 3 channel 8 bit images, not %s",message.encoding.c_str());
+      return;
+    }
+    if(message.data.empty())
+      return;
+
+    int keyframe_interval = 30;
+    nh().getParamCached("keyframe_interval",keyframe_interval);
+
+    //wraps the message data, no copy
+    const RGBImage image(message.height,
+                         message.width,
+                         reinterpret_cast<cv::Vec3b*>(const_cast<unsigned char*>(&message.data[0])),
+                         message.step);
+
+    LabelImagePacket packet;
+    packet.header = message.header;
+    packet.encoding = message.encoding;
+    {
+      boost::mutex::scoped_lock lock(_mutex);
+      _encoder.setKeyframeInterval(keyframe_interval);
+      _encoder.encode(image,packet.data);
+    }
+    publish_fn(packet);
+  }
+
+  void LabelPublisher::connectCallback(const ros::SingleSubscriberPublisher &){
+    boost::mutex::scoped_lock lock(_mutex);
+    _encoder.reset();
+  }
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <boost/thread/mutex.hpp>
+
+#include <image_transport/simple_publisher_plugin.h>
+
+#include <lucrezio_semantic_perception/LabelImagePacket.h>
+#include <lucrezio_semantic_perception/label_codec.h>
+
+namespace lucrezio_semantic_perception{
+
+  //"label" transport: publishes label images as LabelImageEncoder packets.
+  //Parameters, in the namespace of the transport topic (<image>/label):
+  //~keyframe_interval (default 30): one frame out of this many is a keyframe, 1 for no deltas
+  class LabelPublisher : public image_transport::SimplePublisherPlugin<LabelImagePacket>{
+  public:
+    virtual std::string getTransportName() const {return "label";}
+
+  protected:
+    virtual void publish(const sensor_msgs::Image &message, const PublishFn &publish_fn) const;
+
+    //a new subscriber can't decode deltas, the next frame is a keyframe
+    virtual void connectCallback(const ros::SingleSubscriberPublisher &pub);
+
+  private:
+    //publish is const and may be called from several threads
+    mutable boost::mutex _mutex;
+    mutable LabelImageEncoder _encoder;
+  };
+
+}
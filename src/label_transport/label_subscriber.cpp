@@ -0,0 +1,15 @@
+#include "label_subscriber.h"
+
+#include <cv_bridge/cv_bridge.h>
+
+namespace lucrezio_semantic_perception{
+
+  void LabelSubscriber::internalCallback(const LabelImagePacketConstPtr &message, const Callback &user_cb){
+    if(message->data.empty() || !_decoder.decode(&message->data[0],message->data.size())){
+      ROS_WARN_THROTTLE(1,"label transport: can't decode packet, waiting for the next keyframe");
+      return;
+    }
+    user_cb(cv_bridge::CvImage(message->header,message->encoding,_decoder.image()).toImageMsg());
+  }
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <image_transport/simple_subscriber_plugin.h>
+
+#include <lucrezio_semantic_perception/LabelImagePacket.h>
+#include <lucrezio_semantic_perception/label_codec.h>
+
+namespace lucrezio_semantic_perception{
+
+  //"label" transport: decodes LabelImagePacket messages back into images. After a lost
+  //packet, or when subscribing mid-stream, images are delivered again from the next keyframe
+  class LabelSubscriber : public image_transport::SimpleSubscriberPlugin<LabelImagePacket>{
+  public:
+    virtual std::string getTransportName() const {return "label";}
+
+  protected:
+    virtual void internalCallback(const LabelImagePacketConstPtr &message, const Callback &user_cb);
+
+  private:
+    LabelImageDecoder _decoder;
+  };
+
+}
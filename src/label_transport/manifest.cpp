@@ -0,0 +1,7 @@
+#include <pluginlib/class_list_macros.h>
+
+#include "label_publisher.h"
+#include "label_subscriber.h"
+
+PLUGINLIB_EXPORT_CLASS(lucrezio_semantic_perception::LabelPublisher, image_transport::PublisherPlugin)
+PLUGINLIB_EXPORT_CLASS(lucrezio_semantic_perception::LabelSubscriber, image_transport::SubscriberPlugin)
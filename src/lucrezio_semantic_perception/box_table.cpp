@@ -0,0 +1,154 @@
+#include "box_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace lucrezio_semantic_perception{
+
+  BoxTable::BoxTable():
+    _size(0),
+    _capacity(0),
+    _data(0),
+    _x_min(0),
+    _y_min(0),
+    _z_min(0),
+    _x_max(0),
+    _y_max(0),
+    _z_max(0){}
+
+  BoxTable::BoxTable(const BoxTable &other):
+    _size(0),
+    _capacity(0),
+    _data(0),
+    _x_min(0),
+    _y_min(0),
+    _z_min(0),
+    _x_max(0),
+    _y_max(0),
+    _z_max(0){
+    *this = other;
+  }
+
+  BoxTable &BoxTable::operator=(const BoxTable &other){
+    if(this == &other)
+      return *this;
+    if(_capacity < other._size)
+      allocate(other._size);
+    //slots past the copied boxes may hold boxes of the old content, they become padding
+    const float inf = std::numeric_limits<float>::infinity();
+    for(int i=0; i<6; ++i){
+      float *dest = _data+i*_capacity;
+      if(other._size)
+        std::memcpy(dest,other._data+i*other._capacity,other._size*sizeof(float));
+      std::fill(dest+other._size,dest+_capacity,i < 3 ? inf : -inf);
+    }
+    _size = other._size;
+    _class_ids = other._class_ids;
+    _types = other._types;
+    return *this;
+  }
+
+  BoxTable::~BoxTable(){
+    std::free(_data);
+  }
+
+  void BoxTable::allocate(int capacity_){
+    //keeps existing entries, fills the new slots with empty boxes
+    const int capacity = (capacity_+kBlockSize-1)/kBlockSize*kBlockSize;
+    void *data = 0;
+    if(posix_memalign(&data,64,6*capacity*sizeof(float)))
+      throw std::bad_alloc();
+    float *new_data = static_cast<float*>(data);
+
+    const float inf = std::numeric_limits<float>::infinity();
+    for(int i=0; i<6; ++i){
+      float *dest = new_data+i*capacity;
+      std::fill(dest,dest+capacity,i < 3 ? inf : -inf);
+      if(_data)
+        std::memcpy(dest,_data+i*_capacity,_size*sizeof(float));
+    }
+
+    std::free(_data);
+    _data = new_data;
+    _capacity = capacity;
+    _x_min = _data;
+    _y_min = _data+_capacity;
+    _z_min = _data+2*_capacity;
+    _x_max = _data+3*_capacity;
+    _y_max = _data+4*_capacity;
+    _z_max = _data+5*_capacity;
+  }
+
+  void BoxTable::clear(){
+    const float inf = std::numeric_limits<float>::infinity();
+    for(int i=0; i<6; ++i)
+      std::fill(_data+i*_capacity,_data+i*_capacity+_size,i < 3 ? inf : -inf);
+    _size = 0;
+    _class_ids.clear();
+    _types.clear();
+  }
+
+  void BoxTable::reserve(int capacity_){
+    if(capacity_ > _capacity)
+      allocate(capacity_);
+    _class_ids.reserve(capacity_);
+  }
+
+  int BoxTable::add(const Eigen::Vector3f &min_, const Eigen::Vector3f &max_, const std::string &type_){
+    if(_size == _capacity)
+      allocate(std::max(2*_capacity,(int)kBlockSize));
+
+    _x_min[_size] = min_.x();
+    _y_min[_size] = min_.y();
+    _z_min[_size] = min_.z();
+    _x_max[_size] = max_.x();
+    _y_max[_size] = max_.y();
+    _z_max[_size] = max_.z();
+
+    std::vector<std::string>::const_iterator it = std::find(_types.begin(),_types.end(),type_);
+    int class_id = it-_types.begin();
+    if(it == _types.end())
+      _types.push_back(type_);
+    _class_ids.push_back(class_id);
+
+    return _size++;
+  }
+
+  int BoxTable::add(const Eigen::Vector3f &min_, const Eigen::Vector3f &max_, double margin, const std::string &type_){
+    const float inf = std::numeric_limits<float>::infinity();
+    Eigen::Vector3f min,max;
+    for(int k=0; k<3; ++k){
+      const double lower = min_[k]-margin;
+      const double upper = max_[k]+margin;
+      min[k] = (float)lower;
+      max[k] = (float)upper;
+      if(min[k] < lower)
+        min[k] = std::nextafter(min[k],inf);
+      if(max[k] > upper)
+        max[k] = std::nextafter(max[k],-inf);
+    }
+    return add(min,max,type_);
+  }
+
+  void BoxTable::select(const BoxTable &source, const std::vector<int> &indices){
+    clear();
+    const int num_indices = indices.size();
+    reserve(num_indices);
+    for(int k=0; k < num_indices; ++k){
+      const int i = indices[k];
+      _x_min[k] = source._x_min[i];
+      _y_min[k] = source._y_min[i];
+      _z_min[k] = source._z_min[i];
+      _x_max[k] = source._x_max[i];
+      _y_max[k] = source._y_max[i];
+      _z_max[k] = source._z_max[i];
+      _class_ids.push_back(source._class_ids[i]);
+    }
+    _size = num_indices;
+  }
+
+}
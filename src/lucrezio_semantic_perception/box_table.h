@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace lucrezio_semantic_perception{
+
+  //packed structure-of-arrays storage for axis-aligned 3D boxes.
+  //Each coordinate lives in its own 64-byte aligned array padded to a multiple of
+  //kBlockSize entries; padding slots hold empty boxes (min=+inf, max=-inf) so that
+  //a vector test over a whole block never reports them. Type strings are stored
+  //once and referenced by integer class id.
+  class BoxTable{
+  public:
+    static const int kBlockSize = 16;
+
+    BoxTable();
+    BoxTable(const BoxTable &other);
+    BoxTable &operator=(const BoxTable &other);
+    ~BoxTable();
+
+    void clear();
+
+    void reserve(int capacity_);
+
+    //appends a box and returns its index
+    int add(const Eigen::Vector3f &min_, const Eigen::Vector3f &max_, const std::string &type_);
+
+    //appends the box grown by margin on every side. Bounds are computed in double and
+    //rounded towards the box, so that testing a float point against them gives the same
+    //answer as testing it against min_-margin and max_+margin in double
+    int add(const Eigen::Vector3f &min_, const Eigen::Vector3f &max_, double margin, const std::string &type_);
+
+    //replaces the content with the given entries of source, in the given order. Types
+    //are not copied: class ids still index source.types()
+    void select(const BoxTable &source, const std::vector<int> &indices);
+
+    inline int size() const {return _size;}
+    inline bool empty() const {return _size == 0;}
+    //number of slots including padding, always a multiple of kBlockSize
+    inline int paddedSize() const {return (_size+kBlockSize-1)/kBlockSize*kBlockSize;}
+
+    inline const float *xMin() const {return _x_min;}
+    inline const float *yMin() const {return _y_min;}
+    inline const float *zMin() const {return _z_min;}
+    inline const float *xMax() const {return _x_max;}
+    inline const float *yMax() const {return _y_max;}
+    inline const float *zMax() const {return _z_max;}
+
+    inline int classId(int i) const {return _class_ids[i];}
+    inline const std::vector<int> &classIds() const {return _class_ids;}
+    inline const std::string &type(int i) const {return _types[_class_ids[i]];}
+    //distinct types, indexed by class id
+    inline const std::vector<std::string> &types() const {return _types;}
+
+  private:
+    int _size;
+    int _capacity;
+    float *_data;
+    float *_x_min;
+    float *_y_min;
+    float *_z_min;
+    float *_x_max;
+    float *_y_max;
+    float *_z_max;
+    std::vector<int> _class_ids;
+    std::vector<std::string> _types;
+
+    void allocate(int capacity_);
+  };
+
+}
@@ -0,0 +1,101 @@
+#include "box_test.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LUCREZIO_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace lucrezio_semantic_perception{
+
+  int firstHitScalar(const BoxTable &table, float x, float y, float z){
+    const float *x_min = table.xMin();
+    const float *y_min = table.yMin();
+    const float *z_min = table.zMin();
+    const float *x_max = table.xMax();
+    const float *y_max = table.yMax();
+    const float *z_max = table.zMax();
+    const int num_boxes = table.size();
+    for(int j=0; j < num_boxes; ++j)
+      if(x >= x_min[j] && x <= x_max[j] &&
+         y >= y_min[j] && y <= y_max[j] &&
+         z >= z_min[j] && z <= z_max[j])
+        return j;
+    return -1;
+  }
+
+#ifdef LUCREZIO_X86_DISPATCH
+
+  __attribute__((target("avx2")))
+  int firstHitAVX2(const BoxTable &table, float x, float y, float z){
+    const __m256 px = _mm256_set1_ps(x);
+    const __m256 py = _mm256_set1_ps(y);
+    const __m256 pz = _mm256_set1_ps(z);
+    const int num_slots = table.paddedSize();
+    for(int j=0; j < num_slots; j+=8){
+      __m256 m = _mm256_and_ps(_mm256_cmp_ps(px,_mm256_load_ps(table.xMin()+j),_CMP_GE_OQ),
+                               _mm256_cmp_ps(px,_mm256_load_ps(table.xMax()+j),_CMP_LE_OQ));
+      m = _mm256_and_ps(m,_mm256_cmp_ps(py,_mm256_load_ps(table.yMin()+j),_CMP_GE_OQ));
+      m = _mm256_and_ps(m,_mm256_cmp_ps(py,_mm256_load_ps(table.yMax()+j),_CMP_LE_OQ));
+      m = _mm256_and_ps(m,_mm256_cmp_ps(pz,_mm256_load_ps(table.zMin()+j),_CMP_GE_OQ));
+      m = _mm256_and_ps(m,_mm256_cmp_ps(pz,_mm256_load_ps(table.zMax()+j),_CMP_LE_OQ));
+      const int bits = _mm256_movemask_ps(m);
+      if(bits)
+        return j+__builtin_ctz(bits);
+    }
+    return -1;
+  }
+
+  __attribute__((target("avx512f")))
+  int firstHitAVX512(const BoxTable &table, float x, float y, float z){
+    const __m512 px = _mm512_set1_ps(x);
+    const __m512 py = _mm512_set1_ps(y);
+    const __m512 pz = _mm512_set1_ps(z);
+    const int num_slots = table.paddedSize();
+    for(int j=0; j < num_slots; j+=16){
+      __mmask16 m = _mm512_cmp_ps_mask(px,_mm512_load_ps(table.xMin()+j),_CMP_GE_OQ);
+      m = _mm512_mask_cmp_ps_mask(m,px,_mm512_load_ps(table.xMax()+j),_CMP_LE_OQ);
+      m = _mm512_mask_cmp_ps_mask(m,py,_mm512_load_ps(table.yMin()+j),_CMP_GE_OQ);
+      m = _mm512_mask_cmp_ps_mask(m,py,_mm512_load_ps(table.yMax()+j),_CMP_LE_OQ);
+      m = _mm512_mask_cmp_ps_mask(m,pz,_mm512_load_ps(table.zMin()+j),_CMP_GE_OQ);
+      m = _mm512_mask_cmp_ps_mask(m,pz,_mm512_load_ps(table.zMax()+j),_CMP_LE_OQ);
+      if(m)
+        return j+__builtin_ctz(m);
+    }
+    return -1;
+  }
+
+  FirstHitFunction selectFirstHitFunction(){
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+      return firstHitAVX512;
+    if(__builtin_cpu_supports("avx2"))
+      return firstHitAVX2;
+    return firstHitScalar;
+  }
+
+#else
+
+  int firstHitAVX2(const BoxTable &table, float x, float y, float z){
+    return firstHitScalar(table,x,y,z);
+  }
+
+  int firstHitAVX512(const BoxTable &table, float x, float y, float z){
+    return firstHitScalar(table,x,y,z);
+  }
+
+  FirstHitFunction selectFirstHitFunction(){
+    return firstHitScalar;
+  }
+
+#endif
+
+  const char* firstHitIsaName(){
+    FirstHitFunction function = selectFirstHitFunction();
+    if(function == firstHitAVX512)
+      return "avx512";
+    if(function == firstHitAVX2)
+      return "avx2";
+    return "scalar";
+  }
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "box_table.h"
+
+namespace lucrezio_semantic_perception{
+
+  //point-in-box kernels over a BoxTable. Boxes are tested as closed intervals
+  //in float, so any tolerance must already be folded into the table.
+
+  //returns the index of the first box containing (x,y,z), -1 if none
+  typedef int (*FirstHitFunction)(const BoxTable &table, float x, float y, float z);
+
+  int firstHitScalar(const BoxTable &table, float x, float y, float z);
+  int firstHitAVX2(const BoxTable &table, float x, float y, float z);
+  int firstHitAVX512(const BoxTable &table, float x, float y, float z);
+
+  //picks the widest kernel supported by the running cpu
+  FirstHitFunction selectFirstHitFunction();
+
+  //name of the instruction set used by selectFirstHitFunction
+  const char* firstHitIsaName();
+
+}
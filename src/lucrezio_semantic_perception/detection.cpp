@@ -6,8 +6,50 @@ namespace lucrezio_semantic_perception{
                        const Eigen::Vector2i &bottom_right_,
                        const std::vector<Eigen::Vector2i> &pixels_):
     _type(type_),
+    _id(-1),
     _top_left(top_left_),
     _bottom_right(bottom_right_),
-    _pixels(pixels_){}
+    _pixels(pixels_),
+    _mask_origin(Eigen::Vector2i::Zero()),
+    _mask_rows(0),
+    _mask_cols(0),
+    _num_pixels(pixels_.size()),
+    _centroid(Eigen::Vector2f::Zero()),
+    _mean_depth(0),
+    _median_depth(0),
+    _min_point(Eigen::Vector3f::Zero()),
+    _max_point(Eigen::Vector3f::Zero()){}
+
+  void Detection::clear(){
+    _top_left = Eigen::Vector2i(10000,10000);
+    _bottom_right = Eigen::Vector2i(-10000,-10000);
+    _pixels.clear();
+    _mask_origin.setZero();
+    _mask_rows = 0;
+    _mask_cols = 0;
+    _mask.clear();
+    _num_pixels = 0;
+    _centroid.setZero();
+    _mean_depth = 0;
+    _median_depth = 0;
+    _min_point.setZero();
+    _max_point.setZero();
+  }
+
+  void Detection::releasePixels(){
+    std::vector<Eigen::Vector2i>().swap(_pixels);
+    std::vector<bool>().swap(_mask);
+  }
+
+  void Detection::setMaskWindow(const Eigen::Vector2i &mask_origin_, int mask_rows_, int mask_cols_){
+    _mask_origin = mask_origin_;
+    _mask_rows = mask_rows_;
+    _mask_cols = mask_cols_;
+    _mask.assign(_mask_rows*_mask_cols,false);
+    for(size_t i=0; i < _pixels.size(); ++i)
+      addMaskPixel(_pixels[i].y(),_pixels[i].x());
+    //keeps the capacity, no larger than the cap, for the next frames
+    _pixels.clear();
+  }
 
 }
@@ -19,18 +19,93 @@ namespace lucrezio_semantic_perception{
 
     inline const std::string &type() const {return _type;}
     inline std::string &type() {return _type;}
+    //instance id, the same for a model name across frames, -1 if not assigned
+    inline int id() const {return _id;}
+    inline int &id() {return _id;}
     inline const Eigen::Vector2i &topLeft() const {return _top_left;}
     inline Eigen::Vector2i &topLeft() {return _top_left;}
     inline const Eigen::Vector2i &bottomRight() const {return _bottom_right;}
     inline Eigen::Vector2i &bottomRight() {return _bottom_right;}
+    //(col,row) of every pixel, empty once they are kept in the mask
     inline const std::vector<Eigen::Vector2i> &pixels() const {return _pixels;}
     inline std::vector<Eigen::Vector2i> &pixels() {return _pixels;}
 
+    //pixels can be kept as a bit mask over a window of the image instead of a list
+    //(see ObjectDetector::setMaxDetectionPixels); maskOrigin is (col,row) like pixels
+    inline bool hasMask() const {return !_mask.empty();}
+    inline const Eigen::Vector2i &maskOrigin() const {return _mask_origin;}
+    inline int maskRows() const {return _mask_rows;}
+    inline int maskCols() const {return _mask_cols;}
+    inline const std::vector<bool> &mask() const {return _mask;}
+
+    //empties the pixels and the statistics, keeping type, id and the capacity of the pixel
+    //list and the mask, so that a detection reused across frames doesn't allocate again
+    void clear();
+
+    //frees the pixel list and the mask
+    void releasePixels();
+
+    //moves the pixels to a mask over the window, which must hold them all
+    void setMaskWindow(const Eigen::Vector2i &mask_origin_, int mask_rows_, int mask_cols_);
+
+    //(r,c) must be inside the window
+    inline void addMaskPixel(int r, int c){
+      _mask[(r-_mask_origin.y())*_mask_cols+c-_mask_origin.x()] = true;
+    }
+
+    //calls function(r,c) for every pixel, whether it is listed or in the mask
+    template <typename Function>
+    void forEachPixel(Function function) const {
+      if(!hasMask()){
+        for(size_t i=0; i < _pixels.size(); ++i)
+          function(_pixels[i].y(),_pixels[i].x());
+        return;
+      }
+      for(int r=0; r < _mask_rows; ++r)
+        for(int c=0; c < _mask_cols; ++c)
+          if(_mask[r*_mask_cols+c])
+            function(_mask_origin.y()+r,_mask_origin.x()+c);
+    }
+
+    //bytes allocated for the pixel list and the mask
+    inline size_t pixelMemory() const {
+      return _pixels.capacity()*sizeof(Eigen::Vector2i)+_mask.capacity()/8;
+    }
+
+    //summary statistics, accumulated while the pixels are assigned
+    inline int numPixels() const {return _num_pixels;}
+    inline int &numPixels() {return _num_pixels;}
+    //mean pixel position, (row,col) like topLeft and bottomRight
+    inline const Eigen::Vector2f &centroid() const {return _centroid;}
+    inline Eigen::Vector2f &centroid() {return _centroid;}
+    inline float meanDepth() const {return _mean_depth;}
+    inline float &meanDepth() {return _mean_depth;}
+    //approximated by a depth histogram
+    inline float medianDepth() const {return _median_depth;}
+    inline float &medianDepth() {return _median_depth;}
+    //extent of the observed points, in the camera frame
+    inline const Eigen::Vector3f &minPoint() const {return _min_point;}
+    inline Eigen::Vector3f &minPoint() {return _min_point;}
+    inline const Eigen::Vector3f &maxPoint() const {return _max_point;}
+    inline Eigen::Vector3f &maxPoint() {return _max_point;}
+
   private:
     std::string _type;
+    int _id;
     Eigen::Vector2i _top_left;
     Eigen::Vector2i _bottom_right;
     std::vector<Eigen::Vector2i> _pixels;
+    Eigen::Vector2i _mask_origin;
+    int _mask_rows;
+    int _mask_cols;
+    std::vector<bool> _mask;
+
+    int _num_pixels;
+    Eigen::Vector2f _centroid;
+    float _mean_depth;
+    float _median_depth;
+    Eigen::Vector3f _min_point;
+    Eigen::Vector3f _max_point;
   };
 
   }
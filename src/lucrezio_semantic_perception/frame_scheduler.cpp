@@ -0,0 +1,145 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lucrezio_semantic_perception{
+
+  namespace{
+    //weight of the newest sample in the moving averages
+    const double kSmoothing = 0.2;
+
+    //finer levels than the current one must fit with this much headroom, so that
+    //the scheduler doesn't oscillate between two levels
+    const double kHeadroom = 0.8;
+  }
+
+  FrameScheduler::FrameScheduler():
+    _target_rate(0),
+    _latency_budget(0),
+    _max_pyramid_level(1),
+    _max_frame_skip(8),
+    _period(-1),
+    _costs(2,-1),
+    _last_arrival(-1),
+    _frame_counter(0),
+    _num_accepted(0),
+    _num_skipped(0){
+    _decision.reason = "measuring";
+  }
+
+  void FrameScheduler::setTargetRate(double target_rate_){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _target_rate = target_rate_;
+  }
+
+  void FrameScheduler::setLatencyBudget(double latency_budget_){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _latency_budget = latency_budget_;
+  }
+
+  void FrameScheduler::setMaxPyramidLevel(int max_pyramid_level_){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_pyramid_level = std::max(0,max_pyramid_level_);
+    _costs.resize(_max_pyramid_level+1,-1);
+  }
+
+  void FrameScheduler::setMaxFrameSkip(int max_frame_skip_){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_frame_skip = std::max(1,max_frame_skip_);
+  }
+
+  bool FrameScheduler::accept(double now, int &pyramid_level){
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_last_arrival >= 0 && now > _last_arrival)
+      _period = _period < 0 ? now-_last_arrival : (1-kSmoothing)*_period+kSmoothing*(now-_last_arrival);
+    _last_arrival = now;
+    decide();
+
+    pyramid_level = _decision.pyramid_level;
+    const bool process = !(_frame_counter % _decision.frame_skip);
+    ++_frame_counter;
+    if(process)
+      ++_num_accepted;
+    else
+      ++_num_skipped;
+    return process;
+  }
+
+  void FrameScheduler::update(int pyramid_level, double cost, double latency){
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(pyramid_level < 0 || pyramid_level >= (int)_costs.size())
+      return;
+    double &level_cost = _costs[pyramid_level];
+    level_cost = level_cost < 0 ? cost : (1-kSmoothing)*level_cost+kSmoothing*cost;
+    _decision.latency = latency;
+    decide();
+  }
+
+  FrameScheduler::Decision FrameScheduler::decision() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _decision;
+  }
+
+  double FrameScheduler::estimateCost(int pyramid_level) const {
+    //the measured level closest to the requested one
+    int measured = -1;
+    for(int i=0; i < (int)_costs.size(); ++i)
+      if(_costs[i] >= 0 && (measured < 0 || std::abs(i-pyramid_level) < std::abs(measured-pyramid_level)))
+        measured = i;
+    if(measured < 0)
+      return -1;
+    return _costs[measured]*std::pow(4.0,measured-pyramid_level);
+  }
+
+  void FrameScheduler::decide(){
+    Decision &decision = _decision;
+    const int previous_skip = decision.frame_skip;
+    decision.input_rate = _period > 0 ? 1/_period : 0;
+
+    const bool constrained = (_target_rate > 0 || _latency_budget > 0);
+    if(!constrained || estimateCost(0) < 0 || _period < 0){
+      decision.pyramid_level = 0;
+      decision.frame_skip = 1;
+      decision.output_rate = decision.input_rate;
+      decision.cost = std::max(0.0,estimateCost(0));
+      decision.reason = constrained ? "measuring" : "unconstrained";
+    } else {
+      //the coarsest level is used, skipping as many frames as allowed, if none fits
+      int level = _max_pyramid_level;
+      int skip = _max_frame_skip;
+      decision.reason = "over budget";
+      const double reachable_rate = _target_rate > 0 ? std::min(_target_rate,decision.input_rate) : 0;
+      for(int i=0; i <= _max_pyramid_level; ++i){
+        double cost = estimateCost(i);
+        if(i < decision.pyramid_level)
+          cost /= kHeadroom;
+        if(_latency_budget > 0 && cost > _latency_budget)
+          continue;
+
+        //skip enough frames to keep up with the input
+        const int frame_skip = std::max(1,(int)std::ceil(cost/_period));
+        if(frame_skip > _max_frame_skip)
+          continue;
+        if(decision.input_rate/frame_skip < 0.99*reachable_rate)
+          continue;
+
+        level = i;
+        skip = frame_skip;
+        if(i)
+          decision.reason = "reduced resolution";
+        else
+          decision.reason = frame_skip > 1 ? "skipping frames" : "full rate";
+        break;
+      }
+      decision.pyramid_level = level;
+      decision.frame_skip = skip;
+      decision.output_rate = decision.input_rate/skip;
+      decision.cost = estimateCost(level);
+    }
+
+    if(decision.frame_skip != previous_skip)
+      _frame_counter = 0;
+  }
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lucrezio_semantic_perception{
+
+  //decides which incoming frames are processed, and at which pyramid level, from
+  //the measured input rate and detector cost. Every frame is processed at full
+  //resolution while the detector keeps up; otherwise one frame every frameSkip is
+  //processed so that frames don't queue up, and the pyramid level is raised when
+  //that would miss the target output rate or the latency budget.
+  //accept and update can be called from different threads.
+  class FrameScheduler{
+  public:
+    struct Decision{
+      Decision():pyramid_level(0),frame_skip(1),input_rate(0),output_rate(0),cost(0),latency(0){}
+      int pyramid_level;
+      //one frame out of frame_skip is processed
+      int frame_skip;
+      //frames per second, measured and expected
+      double input_rate;
+      double output_rate;
+      //estimated compute time at pyramid_level and last end-to-end latency, in seconds
+      double cost;
+      double latency;
+      std::string reason;
+    };
+
+    FrameScheduler();
+
+    //processed frames per second to reach, 0 for no target
+    void setTargetRate(double target_rate_);
+
+    //maximum compute time of a frame in seconds, 0 for no budget
+    void setLatencyBudget(double latency_budget_);
+
+    void setMaxPyramidLevel(int max_pyramid_level_);
+
+    void setMaxFrameSkip(int max_frame_skip_);
+
+    //called for every incoming frame, now in seconds; returns true if the frame
+    //should be processed, at the returned pyramid level
+    bool accept(double now, int &pyramid_level);
+
+    //reports the compute time and end-to-end latency of a frame processed at pyramid_level
+    void update(int pyramid_level, double cost, double latency);
+
+    Decision decision() const;
+
+    inline unsigned long numAccepted() const {return _num_accepted;}
+    inline unsigned long numSkipped() const {return _num_skipped;}
+
+  private:
+    mutable std::mutex _mutex;
+
+    double _target_rate;
+    double _latency_budget;
+    int _max_pyramid_level;
+    int _max_frame_skip;
+
+    //exponential moving averages, negative until measured
+    double _period;
+    std::vector<double> _costs;
+    double _last_arrival;
+
+    int _frame_counter;
+    Decision _decision;
+
+    std::atomic<unsigned long> _num_accepted;
+    std::atomic<unsigned long> _num_skipped;
+
+    //cost at a level, extrapolated from the measured levels (a level has 4 times fewer pixels
+    //than the previous one), negative if nothing was measured yet
+    double estimateCost(int pyramid_level) const;
+
+    void decide();
+  };
+
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <functional>
+
+namespace lucrezio_semantic_perception{
+
+  //matches the messages of three streams by timestamp. The second stream is the
+  //reference: each of its messages is paired with the closest message of each of
+  //the other two streams, provided both are within maxSkew seconds of it. Messages
+  //older than maxAge seconds are dropped when they arrive or as soon as another
+  //message arrives, and each stream holds at most queueSize messages, so a slow
+  //consumer makes the synchronizer drop frames instead of matching stale ones.
+  //Messages of a stream are expected in timestamp order. The add methods must be
+  //called from a single thread; the counters can be read from any thread.
+  template <typename First, typename Reference, typename Third>
+  class FrameSynchronizer{
+  public:
+    typedef std::function<void(const First&, const Reference&, const Third&)> Callback;
+
+    FrameSynchronizer(double max_skew_ = 0.05, double max_age_ = 0.5, size_t queue_size_ = 5):
+      _max_skew(max_skew_),
+      _max_age(max_age_),
+      _queue_size(queue_size_),
+      _num_matched(0),
+      _num_dropped(0),
+      _num_skewed(0){}
+
+    inline void setCallback(const Callback &callback_){_callback = callback_;}
+    inline void setMaxSkew(double max_skew_){_max_skew = max_skew_;}
+    inline void setMaxAge(double max_age_){_max_age = max_age_;}
+    inline void setQueueSize(size_t queue_size_){_queue_size = queue_size_;}
+
+    //stamp is the timestamp of the message and now the current time, both in seconds
+    inline void addFirst(const First &message_, double stamp_, double now_){add(_first,message_,stamp_,now_);}
+    inline void addReference(const Reference &message_, double stamp_, double now_){add(_reference,message_,stamp_,now_);}
+    inline void addThird(const Third &message_, double stamp_, double now_){add(_third,message_,stamp_,now_);}
+
+    inline double maxSkew() const {return _max_skew;}
+    inline double maxAge() const {return _max_age;}
+    inline size_t queueSize() const {return _queue_size;}
+    //triples passed to the callback
+    inline unsigned long numMatched() const {return _num_matched;}
+    //messages of any stream discarded for being too old, superseded or over the queue size
+    inline unsigned long numDropped() const {return _num_dropped;}
+    //reference messages discarded because a stream had no message within maxSkew of them
+    inline unsigned long numSkewed() const {return _num_skewed;}
+
+  private:
+    template <typename Message>
+    struct Entry{
+      Entry(double stamp_, const Message &message_):stamp(stamp_),message(message_){}
+      double stamp;
+      Message message;
+    };
+
+    double _max_skew;
+    double _max_age;
+    size_t _queue_size;
+    Callback _callback;
+
+    std::deque<Entry<First> > _first;
+    std::deque<Entry<Reference> > _reference;
+    std::deque<Entry<Third> > _third;
+
+    std::atomic<unsigned long> _num_matched;
+    std::atomic<unsigned long> _num_dropped;
+    std::atomic<unsigned long> _num_skewed;
+
+    template <typename Message>
+    void add(std::deque<Entry<Message> > &queue, const Message &message, double stamp, double now){
+      //stale messages never enter the queues
+      if(now-stamp > _max_age){
+        ++_num_dropped;
+        return;
+      }
+
+      //keep the queue sorted, late messages are rare
+      typename std::deque<Entry<Message> >::iterator it = queue.end();
+      while(it != queue.begin() && (it-1)->stamp > stamp)
+        --it;
+      queue.insert(it,Entry<Message>(stamp,message));
+      if(queue.size() > _queue_size){
+        queue.pop_front();
+        ++_num_dropped;
+      }
+
+      prune(_first,now);
+      prune(_reference,now);
+      prune(_third,now);
+      match();
+    }
+
+    template <typename Message>
+    void prune(std::deque<Entry<Message> > &queue, double now){
+      while(!queue.empty() && now-queue.front().stamp > _max_age){
+        queue.pop_front();
+        ++_num_dropped;
+      }
+    }
+
+    //index of the message closest to stamp, -1 if the queue is empty
+    template <typename Message>
+    int closest(const std::deque<Entry<Message> > &queue, double stamp) const {
+      int best = -1;
+      for(size_t i=0; i < queue.size(); ++i)
+        if(best < 0 || std::fabs(queue[i].stamp-stamp) < std::fabs(queue[best].stamp-stamp))
+          best = i;
+      return best;
+    }
+
+    //true if the stream can't hold a partner for stamp anymore: it has no message within
+    //the skew, and it already holds one past it
+    template <typename Message>
+    bool unmatchable(const std::deque<Entry<Message> > &queue, int index, double stamp) const {
+      if(index >= 0 && std::fabs(queue[index].stamp-stamp) <= _max_skew)
+        return false;
+      return !queue.empty() && queue.back().stamp > stamp+_max_skew;
+    }
+
+    //drops the messages before index, which are older than the matched one
+    template <typename Message>
+    void popMatched(std::deque<Entry<Message> > &queue, int index){
+      _num_dropped += index;
+      queue.erase(queue.begin(),queue.begin()+index+1);
+    }
+
+    void match(){
+      while(!_reference.empty()){
+        const double stamp = _reference.front().stamp;
+        const int first = closest(_first,stamp);
+        const int third = closest(_third,stamp);
+
+        if(unmatchable(_first,first,stamp) || unmatchable(_third,third,stamp)){
+          _reference.pop_front();
+          ++_num_skewed;
+          continue;
+        }
+
+        //wait for the missing messages
+        if(first < 0 || third < 0 ||
+           std::fabs(_first[first].stamp-stamp) > _max_skew ||
+           std::fabs(_third[third].stamp-stamp) > _max_skew)
+          return;
+
+        const First first_message = _first[first].message;
+        const Reference reference_message = _reference.front().message;
+        const Third third_message = _third[third].message;
+        popMatched(_first,first);
+        _reference.pop_front();
+        popMatched(_third,third);
+        ++_num_matched;
+        if(_callback)
+          _callback(first_message,reference_message,third_message);
+      }
+    }
+
+  };
+
+}
@@ -1,5 +1,7 @@
 #include "image_utils.h"
 
+#include <limits>
+
 void convert_16UC1_to_32FC1(cv::Mat &dest, const cv::Mat &src, float scale){
   assert(src.type() == CV_16UC1 && "convert_16UC1_to_32FC1: source image of different type from 16UC1");
   const unsigned short* sptr = (const unsigned short*)src.data;
@@ -16,6 +18,51 @@ void convert_16UC1_to_32FC1(cv::Mat &dest, const cv::Mat &src, float scale){
   }
 }
 
+void initializeDepthLUT(DepthLUT &lut,
+                        const float scale,
+                        const float min_distance,
+                        const float max_distance){
+  lut.resize(65536);
+  lut[0]=0.f;
+  for (int i=1; i<65536; ++i) {
+    float d=scale*i;
+    lut[i]=(d>max_distance||d<min_distance) ? 0.f : d;
+  }
+}
+
+void decodeDepthImage(FloatImage &depth_image,
+                      const cv::Mat &raw_depth_image,
+                      const DepthLUT &lut,
+                      const float min_distance,
+                      const float max_distance){
+  int rows=raw_depth_image.rows;
+  int cols=raw_depth_image.cols;
+  depth_image.create(rows, cols);
+  if (raw_depth_image.type()==CV_16UC1) {
+    if (lut.size()!=65536)
+      throw std::runtime_error("depth LUT should have 65536 entries");
+    const float* table=&lut[0];
+    for (int r=0; r<rows; ++r) {
+      const unsigned short* raw=raw_depth_image.ptr<const unsigned short>(r);
+      float* depth=depth_image.ptr<float>(r);
+      for (int c=0; c<cols; ++c)
+        depth[c]=table[raw[c]];
+    }
+  } else if (raw_depth_image.type()==CV_32FC1) {
+    for (int r=0; r<rows; ++r) {
+      const float* raw=raw_depth_image.ptr<const float>(r);
+      float* depth=depth_image.ptr<float>(r);
+      for (int c=0; c<cols; ++c) {
+        float d=raw[c];
+        //written so that NaNs fail the test
+        depth[c]=(d>=min_distance && d<=max_distance) ? d : 0.f;
+      }
+    }
+  } else {
+    throw std::runtime_error("depth image should be 16UC1 or 32FC1");
+  }
+}
+
 void initializePinholeDirections(Float3Image &directions,
                                  const Eigen::Matrix3f &camera_matrix,
                                  const UnsignedCharImage &mask){
@@ -40,25 +87,62 @@ void initializePinholeDirections(Float3Image &directions,
   }
 }
 
+void initializePinholeRays(Float2Image &rays,
+                           const Eigen::Matrix3f &camera_matrix){
+  int rows=rays.rows;
+  int cols=rays.cols;
+  const Eigen::Matrix3f inverse_camera_matrix=camera_matrix.inverse();
+  for (int r=0; r<rows; ++r) {
+    cv::Vec2f* ray=rays.ptr<cv::Vec2f>(r);
+    for (int c=0; c<cols; ++c, ++ray){
+      //same arithmetic as initializePinholeDirections, whose z is 1
+      Eigen::Vector3f dir=inverse_camera_matrix*Eigen::Vector3f(c,r,1);
+      *ray=cv::Vec2f(dir.x(), dir.y());
+    }
+  }
+}
+
 void computePointsImage(Float3Image& points_image,
                         const Float3Image& directions,
-                        const FloatImage&  depth_image,
+                        const cv::Mat& raw_depth_image,
+                        const DepthLUT& lut,
                         const float min_distance,
-                        const float max_distance){
-  if (directions.size()!=depth_image.size())
+                        const float max_distance,
+                        const int stride){
+  int rows=(raw_depth_image.rows+stride-1)/stride;
+  int cols=(raw_depth_image.cols+stride-1)/stride;
+  if (directions.rows!=rows || directions.cols!=cols)
     throw std::runtime_error("directions and depth image sizes should match");
-  int rows=directions.rows;
-  int cols=directions.cols;
   points_image.create(rows, cols);
-  for (int r=0; r<rows; ++r) {
-    cv::Vec3f* point=points_image.ptr<cv::Vec3f>(r);
-    const cv::Vec3f* direction=directions.ptr<const cv::Vec3f>(r);
-    const float* depth=depth_image.ptr<const float>(r);
-    for (int c=0; c<cols; ++c, ++direction, ++depth, ++point){
-      float d=*depth;
-      if (d>max_distance||d<min_distance)
-        d=0;
-      *point=(*direction)*d;
+  if (raw_depth_image.type()==CV_16UC1) {
+    if (lut.size()!=65536)
+      throw std::runtime_error("depth LUT should have 65536 entries");
+    const float* table=&lut[0];
+    for (int r=0; r<rows; ++r) {
+      cv::Vec3f* point=points_image.ptr<cv::Vec3f>(r);
+      const cv::Vec3f* direction=directions.ptr<const cv::Vec3f>(r);
+      const unsigned short* raw=raw_depth_image.ptr<const unsigned short>(r*stride);
+      for (int c=0; c<cols; ++c, ++direction, ++point, raw+=stride)
+        *point=(*direction)*table[*raw];
+    }
+  } else if (raw_depth_image.type()==CV_32FC1) {
+    for (int r=0; r<rows; ++r) {
+      cv::Vec3f* point=points_image.ptr<cv::Vec3f>(r);
+      const cv::Vec3f* direction=directions.ptr<const cv::Vec3f>(r);
+      const float* raw=raw_depth_image.ptr<const float>(r*stride);
+      for (int c=0; c<cols; ++c, ++direction, ++point, raw+=stride) {
+        float d=*raw;
+        //written so that NaNs fail the test
+        *point=(*direction)*((d>=min_distance && d<=max_distance) ? d : 0.f);
+      }
     }
+  } else {
+    throw std::runtime_error("depth image should be 16UC1 or 32FC1");
   }
 }
+
+void computeImageTiles(ImageTileVector &tiles,
+                       const Float3Image &points_image,
+                       const int tile_size){
+  computeImageTiles(tiles,Float3Points(points_image),tile_size);
+}
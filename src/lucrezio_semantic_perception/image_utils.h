@@ -1,5 +1,9 @@
 #pragma once
 
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
@@ -7,20 +11,232 @@
 #include <Eigen/Geometry>
 
 typedef cv::Mat_<unsigned char> UnsignedCharImage;
+typedef cv::Mat_<int> IntImage;
 typedef cv::Mat_<float> FloatImage;
+typedef cv::Mat_<cv::Vec2f> Float2Image;
 typedef cv::Mat_<cv::Vec3f> Float3Image;
 typedef cv::Mat_<unsigned short> RawDepthImage;
 typedef cv::Mat_<cv::Vec3b> RGBImage;
 
+//summary of the valid points falling in a fixed-size block of the image
+struct ImageTile{
+  int r_min;
+  int c_min;
+  int r_max;
+  int c_max;
+  int num_valid;
+  Eigen::Vector3f min;
+  Eigen::Vector3f max;
+};
+typedef std::vector<ImageTile> ImageTileVector;
+
+//metric depth for every 16 bit raw depth value, 0 where invalid or out of range
+typedef std::vector<float> DepthLUT;
+
 
 void convert_16UC1_to_32FC1(cv::Mat& dest, const cv::Mat& src, float scale = 0.001f);
 
+void initializeDepthLUT(DepthLUT& lut,
+                        const float scale,
+                        const float min_distance,
+                        const float max_distance);
+
+//decodes a 16UC1 (through the LUT) or 32FC1 (metric) depth image in a single pass;
+//invalid and out of range values become 0
+void decodeDepthImage(FloatImage& depth_image,
+                      const cv::Mat& raw_depth_image,
+                      const DepthLUT& lut,
+                      const float min_distance,
+                      const float max_distance);
+
 void initializePinholeDirections(Float3Image& directions,
                                  const Eigen::Matrix3f& camera_matrix,
                                  const UnsignedCharImage& mask=UnsignedCharImage());
 
+//x/z and y/z of the pinhole direction of every pixel, enough to rebuild a point from its depth
+void initializePinholeRays(Float2Image& rays,
+                           const Eigen::Matrix3f& camera_matrix);
+
+//points of every stride-th pixel of a 16UC1 (through the LUT) or 32FC1 (metric) depth image,
+//decoded as they are computed; invalid and out of range depths give a zero point
 void computePointsImage(Float3Image& point_image,
-                          const Float3Image& direction_image,
-                          const FloatImage&  depth_image,
-                          const float min_distance,
-                          const float max_distance);
+                        const Float3Image& direction_image,
+                        const cv::Mat& raw_depth_image,
+                        const DepthLUT& lut,
+                        const float min_distance,
+                        const float max_distance,
+                        const int stride=1);
+
+//points stored explicitly, 12 bytes per pixel
+class Float3Points{
+public:
+  class Row{
+  public:
+    Row(const cv::Vec3f* points_):_points(points_){}
+    //false if the pixel has no valid point
+    inline bool point(cv::Vec3f& p, int c) const {
+      p=_points[c];
+      return cv::norm(p)>=1e-3;
+    }
+  private:
+    const cv::Vec3f* _points;
+  };
+
+  Float3Points(const Float3Image& points_image_):_points_image(points_image_){}
+  inline int rows() const {return _points_image.rows;}
+  inline int cols() const {return _points_image.cols;}
+  inline Row row(int r) const {return Row(_points_image.ptr<const cv::Vec3f>(r));}
+
+private:
+  const Float3Image& _points_image;
+};
+
+//points regenerated on the fly from 16 bit raw depth, its LUT and the pinhole rays,
+//2 bytes per pixel plus a ray table that only changes with the camera matrix
+class CompactPoints{
+public:
+  class Row{
+  public:
+    Row(const unsigned short* depth_, const cv::Vec2f* rays_, const float* lut_):
+      _depth(depth_),_rays(rays_),_lut(lut_){}
+    //false if the pixel has no valid point, same test as Float3Points
+    inline bool point(cv::Vec3f& p, int c) const {
+      const float d=_lut[_depth[c]];
+      const cv::Vec2f& ray=_rays[c];
+      p=cv::Vec3f(ray[0]*d,ray[1]*d,d);
+      return d>0 && (d>=1e-3f || cv::norm(p)>=1e-3);
+    }
+  private:
+    const unsigned short* _depth;
+    const cv::Vec2f* _rays;
+    const float* _lut;
+  };
+
+  CompactPoints(const RawDepthImage& depth_image_, const Float2Image& rays_, const DepthLUT& lut_):
+    _depth_image(depth_image_),_rays(rays_),_lut(&lut_[0]){
+    if (_depth_image.size()!=_rays.size())
+      throw std::runtime_error("rays and depth image sizes should match");
+  }
+  inline int rows() const {return _depth_image.rows;}
+  inline int cols() const {return _depth_image.cols;}
+  inline Row row(int r) const {
+    return Row(_depth_image.ptr<const unsigned short>(r),_rays.ptr<const cv::Vec2f>(r),_lut);
+  }
+
+private:
+  const RawDepthImage& _depth_image;
+  const Float2Image& _rays;
+  const float* _lut;
+};
+
+//PointStorage is Float3Points or CompactPoints
+template <typename PointStorage>
+void computeImageTiles(ImageTileVector& tiles,
+                       const PointStorage& points,
+                       const int tile_size){
+  if (tile_size<=0)
+    throw std::runtime_error("tile size should be positive");
+  int rows=points.rows();
+  int cols=points.cols();
+  int tile_rows=(rows+tile_size-1)/tile_size;
+  int tile_cols=(cols+tile_size-1)/tile_size;
+  tiles.resize(tile_rows*tile_cols);
+
+  for (int tr=0; tr<tile_rows; ++tr) {
+    for (int tc=0; tc<tile_cols; ++tc) {
+      ImageTile& tile=tiles[tr*tile_cols+tc];
+      tile.r_min=tr*tile_size;
+      tile.c_min=tc*tile_size;
+      tile.r_max=std::min(tile.r_min+tile_size,rows)-1;
+      tile.c_max=std::min(tile.c_min+tile_size,cols)-1;
+      tile.num_valid=0;
+      tile.min=Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+      tile.max=Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    }
+  }
+
+  //single pass over the image, row by row
+  cv::Vec3f p;
+  for (int r=0; r<rows; ++r) {
+    const typename PointStorage::Row row=points.row(r);
+    ImageTile* row_tiles=&tiles[(r/tile_size)*tile_cols];
+    for (int c=0; c<cols; ++c){
+      if (!row.point(p,c))
+        continue;
+      ImageTile& tile=row_tiles[c/tile_size];
+      ++tile.num_valid;
+      for (int i=0; i<3; ++i) {
+        if (p[i]<tile.min[i])
+          tile.min[i]=p[i];
+        if (p[i]>tile.max[i])
+          tile.max[i]=p[i];
+      }
+    }
+  }
+}
+
+void computeImageTiles(ImageTileVector& tiles,
+                       const Float3Image& points_image,
+                       const int tile_size);
+
+//tile grid of a Rows x Cols image fixed at compile time; the tiles cover the image
+//exactly, so that none of them is clipped
+template <int Rows, int Cols, int TileSize>
+struct FixedTileGrid{
+  static_assert(Rows%TileSize==0 && Cols%TileSize==0, "tiles should cover the image exactly");
+  enum{rows=Rows, cols=Cols, tile_size=TileSize,
+       tile_rows=Rows/TileSize, tile_cols=Cols/TileSize, num_tiles=tile_rows*tile_cols};
+};
+
+//same tiles as computeImageTiles(tiles,points,Grid::tile_size), with constant loop bounds
+//and no division per pixel; the bounds of a row of tiles are accumulated on the stack
+template <typename Grid, typename PointStorage>
+void computeFixedImageTiles(ImageTileVector& tiles,
+                            const PointStorage& points){
+  if (points.rows()!=Grid::rows || points.cols()!=Grid::cols)
+    throw std::runtime_error("points should have the size of the tile grid");
+  tiles.resize(Grid::num_tiles);
+
+  int num_valid[Grid::tile_cols];
+  float min[Grid::tile_cols][3];
+  float max[Grid::tile_cols][3];
+  cv::Vec3f p;
+  for (int tr=0; tr<Grid::tile_rows; ++tr) {
+    for (int tc=0; tc<Grid::tile_cols; ++tc) {
+      num_valid[tc]=0;
+      for (int i=0; i<3; ++i) {
+        min[tc][i]=std::numeric_limits<float>::max();
+        max[tc][i]=-std::numeric_limits<float>::max();
+      }
+    }
+
+    for (int r=tr*Grid::tile_size; r<(tr+1)*Grid::tile_size; ++r) {
+      const typename PointStorage::Row row=points.row(r);
+      for (int tc=0; tc<Grid::tile_cols; ++tc) {
+        const int c_min=tc*Grid::tile_size;
+        for (int c=c_min; c<c_min+Grid::tile_size; ++c){
+          if (!row.point(p,c))
+            continue;
+          ++num_valid[tc];
+          for (int i=0; i<3; ++i) {
+            if (p[i]<min[tc][i])
+              min[tc][i]=p[i];
+            if (p[i]>max[tc][i])
+              max[tc][i]=p[i];
+          }
+        }
+      }
+    }
+
+    for (int tc=0; tc<Grid::tile_cols; ++tc) {
+      ImageTile& tile=tiles[tr*Grid::tile_cols+tc];
+      tile.r_min=tr*Grid::tile_size;
+      tile.c_min=tc*Grid::tile_size;
+      tile.r_max=tile.r_min+Grid::tile_size-1;
+      tile.c_max=tile.c_min+Grid::tile_size-1;
+      tile.num_valid=num_valid[tc];
+      tile.min=Eigen::Vector3f(min[tc][0],min[tc][1],min[tc][2]);
+      tile.max=Eigen::Vector3f(max[tc][0],max[tc][1],max[tc][2]);
+    }
+  }
+}
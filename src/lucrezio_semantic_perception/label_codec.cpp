@@ -0,0 +1,276 @@
+#include "label_codec.h"
+
+#include <cstring>
+
+namespace lucrezio_semantic_perception{
+
+  namespace{
+
+    const unsigned char kVersion = 1;
+
+    inline void writeVarint(std::vector<unsigned char> &out, unsigned int value){
+      while(value >= 0x80){
+        out.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+      }
+      out.push_back(value);
+    }
+
+    inline bool readVarint(const unsigned char* &data, const unsigned char* end, unsigned int &value){
+      value = 0;
+      for(int shift=0; shift < 35; shift += 7){
+        if(data == end)
+          return false;
+        const unsigned char byte = *data++;
+        value |= (unsigned int)(byte & 0x7f) << shift;
+        if(!(byte & 0x80))
+          return true;
+      }
+      return false;
+    }
+
+    //index of the colour in the palette, added if missing; -1 if the palette is full
+    inline int paletteIndex(std::vector<cv::Vec3b> &palette, const cv::Vec3b &color){
+      for(size_t i=0; i < palette.size(); ++i)
+        if(palette[i] == color)
+          return i;
+      if(palette.size() == 256)
+        return -1;
+      palette.push_back(color);
+      return palette.size()-1;
+    }
+
+    //true if the runs cover exactly num_pixels pixels with colours of the palette
+    bool checkRuns(const unsigned char* data, const unsigned char* end, bool delta,
+                   unsigned int palette_size, size_t num_pixels){
+      size_t position = 0;
+      while(data != end){
+        unsigned int skip = 0;
+        unsigned int length;
+        if(delta){
+          if(!readVarint(data,end,skip))
+            return false;
+          position += skip;
+          if(data == end)
+            break;
+        }
+        if(!readVarint(data,end,length) || data == end)
+          return false;
+        const unsigned int index = *data++;
+        if(index >= palette_size || position+length+1 > num_pixels)
+          return false;
+        position += length+1;
+      }
+      return position == num_pixels;
+    }
+
+    inline void writePalette(std::vector<unsigned char> &out, const std::vector<cv::Vec3b> &palette){
+      writeVarint(out,palette.size());
+      for(size_t i=0; i < palette.size(); ++i)
+        for(int k=0; k < 3; ++k)
+          out.push_back(palette[i][k]);
+    }
+
+  }
+
+  LabelImageEncoder::LabelImageEncoder():
+    _keyframe_interval(30),
+    _sequence(0),
+    _frames_since_keyframe(0),
+    _last_mode(KeyframeMode){}
+
+  bool LabelImageEncoder::encodeRuns(const RGBImage &image){
+    _palette.clear();
+    _runs.clear();
+    cv::Vec3b color = image(0,0);
+    unsigned int length = 0;
+    for(int r=0; r < image.rows; ++r){
+      const cv::Vec3b* pixels = image.ptr<const cv::Vec3b>(r);
+      for(int c=0; c < image.cols; ++c){
+        if(pixels[c] == color){
+          ++length;
+          continue;
+        }
+        const int index = paletteIndex(_palette,color);
+        if(index < 0)
+          return false;
+        writeVarint(_runs,length-1);
+        _runs.push_back(index);
+        color = pixels[c];
+        length = 1;
+      }
+    }
+    const int index = paletteIndex(_palette,color);
+    if(index < 0)
+      return false;
+    writeVarint(_runs,length-1);
+    _runs.push_back(index);
+    return true;
+  }
+
+  bool LabelImageEncoder::encodeDelta(const RGBImage &image, size_t max_size){
+    _delta_palette.clear();
+    _delta_runs.clear();
+    cv::Vec3b color;
+    unsigned int skip = 0;
+    unsigned int length = 0;
+    for(int r=0; r < image.rows; ++r){
+      const cv::Vec3b* pixels = image.ptr<const cv::Vec3b>(r);
+      const cv::Vec3b* previous = _previous.ptr<const cv::Vec3b>(r);
+      for(int c=0; c < image.cols; ++c){
+        if(length && pixels[c] == color && pixels[c] != previous[c]){
+          ++length;
+          continue;
+        }
+        if(length){
+          const int index = paletteIndex(_delta_palette,color);
+          if(index < 0)
+            return false;
+          writeVarint(_delta_runs,skip);
+          writeVarint(_delta_runs,length-1);
+          _delta_runs.push_back(index);
+          if(3*_delta_palette.size()+_delta_runs.size() > max_size)
+            return false;
+          skip = 0;
+          length = 0;
+        }
+        if(pixels[c] == previous[c]){
+          ++skip;
+          continue;
+        }
+        color = pixels[c];
+        length = 1;
+      }
+    }
+    if(length){
+      const int index = paletteIndex(_delta_palette,color);
+      if(index < 0)
+        return false;
+      writeVarint(_delta_runs,skip);
+      writeVarint(_delta_runs,length-1);
+      _delta_runs.push_back(index);
+      skip = 0;
+    }
+    writeVarint(_delta_runs,skip);
+    return 3*_delta_palette.size()+_delta_runs.size() < max_size;
+  }
+
+  void LabelImageEncoder::encode(const RGBImage &image, std::vector<unsigned char> &packet){
+    if(image.empty())
+      throw std::runtime_error("cannot encode an empty label image");
+
+    const bool delta_allowed = (_frames_since_keyframe+1 < _keyframe_interval &&
+                                _previous.rows == image.rows &&
+                                _previous.cols == image.cols);
+
+    _last_mode = RawMode;
+    if(encodeRuns(image)){
+      _last_mode = KeyframeMode;
+      if(delta_allowed && encodeDelta(image,3*_palette.size()+_runs.size()))
+        _last_mode = DeltaMode;
+    }
+
+    packet.clear();
+    packet.push_back(kVersion);
+    packet.push_back(_last_mode);
+    writeVarint(packet,_sequence);
+    writeVarint(packet,image.rows);
+    writeVarint(packet,image.cols);
+    switch(_last_mode){
+    case RawMode:
+      for(int r=0; r < image.rows; ++r){
+        const unsigned char* pixels = image.ptr<const unsigned char>(r);
+        packet.insert(packet.end(),pixels,pixels+3*image.cols);
+      }
+      break;
+    case KeyframeMode:
+      writePalette(packet,_palette);
+      packet.insert(packet.end(),_runs.begin(),_runs.end());
+      break;
+    case DeltaMode:
+      writePalette(packet,_delta_palette);
+      packet.insert(packet.end(),_delta_runs.begin(),_delta_runs.end());
+      break;
+    }
+
+    ++_sequence;
+    _frames_since_keyframe = (_last_mode == DeltaMode ? _frames_since_keyframe+1 : 0);
+    if(_keyframe_interval > 1)
+      image.copyTo(_previous);
+  }
+
+  LabelImageDecoder::LabelImageDecoder():
+    _max_pixels(4096*4096),
+    _valid(false),
+    _sequence(0){}
+
+  bool LabelImageDecoder::decode(const unsigned char* data, size_t size){
+    const unsigned char* end = data+size;
+    unsigned int sequence,rows,cols;
+    if(size < 2 || data[0] != kVersion || data[1] > LabelImageEncoder::DeltaMode){
+      _valid = false;
+      return false;
+    }
+    const LabelImageEncoder::Mode mode = (LabelImageEncoder::Mode)data[1];
+    data += 2;
+    if(!readVarint(data,end,sequence) ||
+       !readVarint(data,end,rows) ||
+       !readVarint(data,end,cols) ||
+       !rows || !cols || rows > 65535 || cols > 65535){
+      _valid = false;
+      return false;
+    }
+
+    if(mode == LabelImageEncoder::DeltaMode &&
+       (!_valid || sequence != _sequence+1 || (unsigned int)_image.rows != rows || (unsigned int)_image.cols != cols)){
+      _valid = false;
+      return false;
+    }
+    _valid = false;
+
+    const size_t num_pixels = (size_t)rows*cols;
+    if(mode == LabelImageEncoder::RawMode){
+      if((size_t)(end-data) != 3*num_pixels)
+        return false;
+      _image.create(rows,cols);
+      for(unsigned int r=0; r < rows; ++r, data += 3*cols)
+        std::memcpy(_image.ptr<unsigned char>(r),data,3*cols);
+      _sequence = sequence;
+      _valid = true;
+      return true;
+    }
+
+    unsigned int palette_size;
+    if(num_pixels > _max_pixels ||
+       !readVarint(data,end,palette_size) || palette_size > 256 || (size_t)(end-data) < 3*palette_size)
+      return false;
+    _palette.resize(palette_size);
+    for(unsigned int i=0; i < palette_size; ++i, data += 3)
+      _palette[i] = cv::Vec3b(data[0],data[1],data[2]);
+    if(!checkRuns(data,end,mode == LabelImageEncoder::DeltaMode,palette_size,num_pixels))
+      return false;
+
+    //the image is continuous, runs are laid out row after row
+    _image.create(rows,cols);
+    cv::Vec3b* pixels = _image.ptr<cv::Vec3b>(0);
+    size_t position = 0;
+    while(data != end){
+      unsigned int skip = 0;
+      unsigned int length;
+      if(mode == LabelImageEncoder::DeltaMode){
+        readVarint(data,end,skip);
+        position += skip;
+        if(data == end)
+          break;
+      }
+      readVarint(data,end,length);
+      std::fill(pixels+position,pixels+position+length+1,_palette[*data++]);
+      position += length+1;
+    }
+
+    _sequence = sequence;
+    _valid = true;
+    return true;
+  }
+
+}
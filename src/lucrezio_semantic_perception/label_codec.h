@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "image_utils.h"
+
+namespace lucrezio_semantic_perception{
+
+  //packs label images, which only hold a handful of distinct colours, as palette
+  //indices: either run-length coded (keyframes) or, against the previous frame, as
+  //runs of changed pixels (deltas). Images with more than 256 colours are sent raw.
+  //Packet layout, counts as LEB128 varints:
+  //  version, mode, sequence, rows, cols, then
+  //  raw:      rows*cols*3 bytes
+  //  keyframe: palette size, palette (3 bytes per colour), runs of (length-1, index)
+  //  delta:    palette size, palette, runs of (unchanged pixels, length-1, index),
+  //            then the number of unchanged pixels left
+  //Channels are stored in the order they come, so any 3 channel 8 bit encoding works.
+  class LabelImageEncoder{
+  public:
+    enum Mode{RawMode, KeyframeMode, DeltaMode};
+
+    LabelImageEncoder();
+
+    //a keyframe every keyframe_interval frames, so that decoders can start or recover
+    //after a lost packet; 1 sends keyframes only
+    inline void setKeyframeInterval(int keyframe_interval_){_keyframe_interval = std::max(1,keyframe_interval_);}
+
+    //the next frame is a keyframe
+    inline void reset(){_previous.release();}
+
+    //deltas are only sent when smaller than the keyframe
+    void encode(const RGBImage &image, std::vector<unsigned char> &packet);
+
+    inline int keyframeInterval() const {return _keyframe_interval;}
+    inline Mode lastMode() const {return _last_mode;}
+
+  private:
+    int _keyframe_interval;
+    unsigned int _sequence;
+    int _frames_since_keyframe;
+    Mode _last_mode;
+    RGBImage _previous;
+
+    std::vector<cv::Vec3b> _palette;
+    std::vector<unsigned char> _runs;
+    std::vector<cv::Vec3b> _delta_palette;
+    std::vector<unsigned char> _delta_runs;
+
+    //false if the image has more than 256 colours
+    bool encodeRuns(const RGBImage &image);
+
+    //false if palette and runs of the delta don't fit in less than max_size bytes
+    bool encodeDelta(const RGBImage &image, size_t max_size);
+  };
+
+  class LabelImageDecoder{
+  public:
+    LabelImageDecoder();
+
+    //largest keyframe or delta accepted, in pixels: a few bytes of runs can describe
+    //any size, raw images are bounded by the packet size instead
+    inline void setMaxPixels(size_t max_pixels_){_max_pixels = max_pixels_;}
+
+    //false if the packet is malformed, or is a delta whose previous frame wasn't decoded;
+    //decoding resumes at the next keyframe. Packets are checked before the image is
+    //allocated or written
+    bool decode(const unsigned char* data, size_t size);
+
+    //last decoded image, overwritten by the next decode
+    inline const RGBImage &image() const {return _image;}
+    inline size_t maxPixels() const {return _max_pixels;}
+
+  private:
+    size_t _max_pixels;
+    RGBImage _image;
+    bool _valid;
+    unsigned int _sequence;
+    std::vector<cv::Vec3b> _palette;
+  };
+
+}
@@ -1,87 +1,174 @@
 #include "object_detector.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace lucrezio_semantic_perception{
 
+  namespace{
+
+    //bytes of the image data, 0 if not allocated
+    inline size_t imageMemory(const cv::Mat &image){
+      return image.empty() ? 0 : image.total()*image.elemSize();
+    }
+
+    inline float cross(const Eigen::Vector2f &o, const Eigen::Vector2f &a, const Eigen::Vector2f &b){
+      return (a.x()-o.x())*(b.y()-o.y())-(a.y()-o.y())*(b.x()-o.x());
+    }
+
+    inline bool lessXY(const Eigen::Vector2f &a, const Eigen::Vector2f &b){
+      return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+    }
+
+    //convex hull of a small point set (monotone chain), counter-clockwise
+    void convexHull(std::vector<Eigen::Vector2f> &hull, std::vector<Eigen::Vector2f> points){
+      std::sort(points.begin(),points.end(),lessXY);
+      const int n = points.size();
+      hull.resize(2*n);
+      int k=0;
+      for(int i=0; i<n; ++i){
+        while(k >= 2 && cross(hull[k-2],hull[k-1],points[i]) <= 0)
+          --k;
+        hull[k++] = points[i];
+      }
+      for(int i=n-2, t=k+1; i>=0; --i){
+        while(k >= t && cross(hull[k-2],hull[k-1],points[i]) <= 0)
+          --k;
+        hull[k++] = points[i];
+      }
+      hull.resize(std::max(k-1,1));
+    }
+
+  }
+
 
   void ObjectDetector::setImages(const RGBImage &rgb_image_,
-                                 const RawDepthImage &raw_depth_image_){
+                                 const cv::Mat &raw_depth_image_){
     //copy images
     _rgb_image = rgb_image_;
-    _raw_depth_image = raw_depth_image_;
 
     _rows = _rgb_image.rows;
     _cols = _rgb_image.cols;
 
-    //compute points image
-    FloatImage depth_image;
-    Float3Image directions_image;
+    if(raw_depth_image_.rows != _rows || raw_depth_image_.cols != _cols)
+      throw std::runtime_error("rgb and depth image sizes should match");
 
-    directions_image.create(_rows,_cols);
-    initializePinholeDirections(directions_image,_K);
-    _points_image.create(_rows,_cols);
-//    convert_16UC1_to_32FC1(depth_image, _raw_depth_image);
+    _compact_points = (_point_format == CompactPointFormat && raw_depth_image_.type() == CV_16UC1);
 
-    computePointsImage(_points_image,
-                       directions_image,
-                       _raw_depth_image,
-                       0.02f,
-                       8.0f);
+    //points read the raw depth through the LUT, decoded depth is only needed to upsample coarse levels
+    if(pyramidStride() > 1)
+      decodeDepthImage(_depth_image,
+                       raw_depth_image_,
+                       _depth_lut,
+                       _min_distance,
+                       _max_distance);
+    else
+      _depth_image.release();
 
-    _label_image.create(_rows,_cols);
+    if(_compact_points)
+      computeCompactCameraPoints(raw_depth_image_);
+    else
+      computeCameraPoints(raw_depth_image_);
+
+    if(_bounded_memory)
+      releaseUnusedBuffers();
+  }
+
+  void ObjectDetector::releaseUnusedBuffers(){
+    //only the size of the rgb image is used
+    _rgb_image.release();
+
+    if(_compact_points){
+      _directions_image.release();
+      _directions_K.setZero();
+      _points_image.release();
+    } else {
+      _raw_depth_image.release();
+      _rays_image.release();
+      _rays_K.setZero();
+    }
 
+    if(_engine != RasterizationEngine)
+      _id_image.release();
+
+    if(!_incremental){
+      _previous_labels.release();
+      _previous_depths.release();
+    }
   }
 
-  void ObjectDetector::readData(char *filename){
+  void ObjectDetector::computeCameraPoints(const cv::Mat &raw_depth_image){
+    const int stride = pyramidStride();
+    const int rows = (_rows+stride-1)/stride;
+    const int cols = (_cols+stride-1)/stride;
+
+    //at coarser pyramid levels sample every stride-th depth value and scale K accordingly
+    _level_K = _K;
+    if(stride > 1)
+      _level_K.topRows<2>() /= stride;
+
+    //directions only change with K, the image size or the pyramid level
+    if(_directions_image.rows != rows ||
+       _directions_image.cols != cols ||
+       _directions_K != _level_K){
+      _directions_image.create(rows,cols);
+      initializePinholeDirections(_directions_image,_level_K);
+      _directions_K = _level_K;
+    }
 
-    std::string line;
-    std::ifstream data(filename);
+    //compute points image, decoding the depth as it is read
+    computePointsImage(_points_image,
+                       _directions_image,
+                       raw_depth_image,
+                       _depth_lut,
+                       _min_distance,
+                       _max_distance,
+                       stride);
+  }
 
-    if(data.is_open()) {
-      if(std::getline(data,line)) {
-        std::istringstream iss(line);
-        double px,py,pz,r00,r01,r02,r10,r11,r12,r20,r21,r22;
-        iss >>px>>py>>pz>>r00>>r01>>r02>>r10>>r11>>r12>>r20>>r21>>r22;
-        _rgbd_camera_transform.translation()=Eigen::Vector3f(px,py,pz);
-        Eigen::Matrix3f R;
-        R << r00,r01,r02,r10,r11,r12,r20,r21,r22;
-        _rgbd_camera_transform.linear().matrix() = R;
-      }
-      if(std::getline(data,line)) {
-        std::istringstream iss(line);
-        double px,py,pz,r00,r01,r02,r10,r11,r12,r20,r21,r22;
-        iss >>px>>py>>pz>>r00>>r01>>r02>>r10>>r11>>r12>>r20>>r21>>r22;
-        _logical_camera_transform.translation()=Eigen::Vector3f(px,py,pz);
-        Eigen::Matrix3f R;
-        R << r00,r01,r02,r10,r11,r12,r20,r21,r22;
-        _logical_camera_transform.linear().matrix() = R;
+  void ObjectDetector::computeCompactCameraPoints(const RawDepthImage &raw_depth_image){
+    const int stride = pyramidStride();
+
+    //keep every stride-th raw value, points are rebuilt by the kernels when they read them
+    _raw_depth_image.create((_rows+stride-1)/stride,(_cols+stride-1)/stride);
+    for(int r=0; r<_raw_depth_image.rows; ++r){
+      unsigned short* depth=_raw_depth_image.ptr<unsigned short>(r);
+      const unsigned short* full_depth=raw_depth_image.ptr<const unsigned short>(r*stride);
+      if(stride == 1){
+        std::copy(full_depth,full_depth+_cols,depth);
+        continue;
       }
-      int n;
-      if(std::getline(data,line)) {
-        std::istringstream iss(line);
-        iss >> n;
-      }
-      for(int i=0; i<n; i++){
-        std::getline(data,line);
-        std::istringstream iss(line);
-        std::string type;
-        double px,py,pz,r00,r01,r02,r10,r11,r12,r20,r21,r22;
-        double minx,miny,minz,maxx,maxy,maxz;
-        iss >> type;
-        Eigen::Isometry3f model_pose=Eigen::Isometry3f::Identity();
-        iss >>px>>py>>pz>>r00>>r01>>r02>>r10>>r11>>r12>>r20>>r21>>r22;
-        model_pose.translation()=Eigen::Vector3f(px,py,pz);
-        Eigen::Matrix3f R;
-        R << r00,r01,r02,r10,r11,r12,r20,r21,r22;
-        model_pose.linear().matrix() = R;
-        iss >> minx>>miny>>minz>>maxx>>maxy>>maxz;
-        Eigen::Vector3f min(minx,miny,minz);
-        Eigen::Vector3f max(maxx,maxy,maxz);
-
-        Model model(type,model_pose,min,max);
-        _models.push_back(model);
-      }
-      data.close();
+      for(int c=0; c<_raw_depth_image.cols; ++c, ++depth, full_depth+=stride)
+        *depth=*full_depth;
     }
+    _level_K = _K;
+    if(stride > 1)
+      _level_K.topRows<2>() /= stride;
+
+    //like the directions, rays only change with K, the image size or the pyramid level
+    if(_rays_image.rows != _raw_depth_image.rows ||
+       _rays_image.cols != _raw_depth_image.cols ||
+       _rays_K != _level_K){
+      _rays_image.create(_raw_depth_image.rows,_raw_depth_image.cols);
+      initializePinholeRays(_rays_image,_level_K);
+      _rays_K = _level_K;
+    }
+  }
+
+  bool ObjectDetector::setSensorResolution(int rows, int cols){
+    _fixed_size_core = (rows == SensorTileGrid::rows && cols == SensorTileGrid::cols);
+    return _fixed_size_core;
+  }
+
+  bool ObjectDetector::readData(const std::string &filename){
+
+    if(!_scene_parser.read(filename,_rgbd_camera_transform,_logical_camera_transform,_models)){
+      std::cerr << "Failed to read scene: " << _scene_parser.error() << std::endl;
+      return false;
+    }
+
+    if(!_verbose)
+      return true;
 
     std::cerr << "RGBD camera pose" << std::endl;
     std::cerr << "position:" << std::endl;
@@ -110,101 +197,718 @@ namespace lucrezio_semantic_perception{
       std::cerr << "Max:" << std::endl;
       std::cerr << model.max().transpose() << std::endl << std::endl;
     }
+    return true;
+  }
+
+  bool ObjectDetector::writeData(const std::string &filename) const{
+    return writeScene(filename,_rgbd_camera_transform,_logical_camera_transform,_models);
   }
 
   void ObjectDetector::computeWorldBoundingBoxes(){
-    Eigen::Isometry3f transform = _rgbd_camera_transform.inverse()*_logical_camera_transform;
+    //cached boxes are only valid for the camera transforms they were computed with
+    const bool camera_moved = (_rgbd_camera_transform.matrix() != _cached_rgbd_camera_transform.matrix() ||
+                               _logical_camera_transform.matrix() != _cached_logical_camera_transform.matrix() ||
+                               !_num_frames);
+    if(camera_moved){
+      _logical_to_rgbd_transform = _rgbd_camera_transform.inverse()*_logical_camera_transform;
+      _cached_rgbd_camera_transform = _rgbd_camera_transform;
+      _cached_logical_camera_transform = _logical_camera_transform;
+    }
+    const Eigen::Isometry3f &transform = _logical_to_rgbd_transform;
+    ++_num_frames;
 
     int num_models=_models.size();
     _bounding_boxes.resize(num_models);
     _detections.resize(num_models);
+    _accumulators.resize(num_models);
+    _box_table.clear();
+    _box_table.reserve(num_models);
 
-    std::cerr << "Computing world bounding boxes for " << num_models << " models" << std::endl;
+    if(_verbose)
+      std::cerr << "Computing world bounding boxes for " << num_models << " models" << std::endl;
     for(int i=0; i<num_models; ++i){
       const Model &model = _models[i];
       const Eigen::Isometry3f& model_pose=model.pose();
 
-      std::vector<Eigen::Vector3f> points;
-      points.push_back(transform*model_pose*Eigen::Vector3f(model.min().x(),model.min().y(),model.min().z()));
-      points.push_back(transform*model_pose*Eigen::Vector3f(model.max().x(),model.max().y(),model.max().z()));
-
-      float x_min=100000,x_max=-100000,y_min=100000,y_max=-100000,z_min=100000,z_max=-100000;
-      for(int i=0; i < 2; ++i){
-        if(points[i].x()<x_min)
-          x_min = points[i].x();
-        if(points[i].x()>x_max)
-          x_max = points[i].x();
-        if(points[i].y()<y_min)
-          y_min = points[i].y();
-        if(points[i].y()>y_max)
-          y_max = points[i].y();
-        if(points[i].z()<z_min)
-          z_min = points[i].z();
-        if(points[i].z()>z_max)
-          z_max = points[i].z();
+      bool seen = true;
+      ModelTable::iterator it = _model_table.find(model.type());
+      if(it == _model_table.end()){
+        it = _model_table.insert(std::make_pair(model.type(),CachedModel())).first;
+        seen = false;
       }
-      _bounding_boxes[i] = std::make_pair(Eigen::Vector3f(x_min,y_min,z_min),Eigen::Vector3f(x_max,y_max,z_max));
+      CachedModel &cached = it->second;
+
+      //only models that moved, changed size or are new need their box recomputed
+      const bool hit = (!camera_moved &&
+                        seen &&
+                        cached.last_frame+1 == _num_frames &&
+                        cached.pose.matrix() == model_pose.matrix() &&
+                        cached.min == model.min() &&
+                        cached.max == model.max());
+      if(hit){
+        ++_num_model_hits;
+      } else {
+        ++_num_model_misses;
+        std::vector<Eigen::Vector3f> points;
+        points.push_back(transform*model_pose*Eigen::Vector3f(model.min().x(),model.min().y(),model.min().z()));
+        points.push_back(transform*model_pose*Eigen::Vector3f(model.max().x(),model.max().y(),model.max().z()));
+
+        float x_min=100000,x_max=-100000,y_min=100000,y_max=-100000,z_min=100000,z_max=-100000;
+        for(int i=0; i < 2; ++i){
+          if(points[i].x()<x_min)
+            x_min = points[i].x();
+          if(points[i].x()>x_max)
+            x_max = points[i].x();
+          if(points[i].y()<y_min)
+            y_min = points[i].y();
+          if(points[i].y()>y_max)
+            y_max = points[i].y();
+          if(points[i].z()<z_min)
+            z_min = points[i].z();
+          if(points[i].z()>z_max)
+            z_max = points[i].z();
+        }
+        cached.pose = model_pose;
+        cached.min = model.min();
+        cached.max = model.max();
+        cached.box = std::make_pair(Eigen::Vector3f(x_min,y_min,z_min),Eigen::Vector3f(x_max,y_max,z_max));
+      }
+      cached.last_frame = _num_frames;
+
+      InstanceIdTable::iterator id = _instance_ids.find(model.type());
+      if(id == _instance_ids.end())
+        id = _instance_ids.insert(std::make_pair(model.type(),InstanceId(_next_instance_id++))).first;
+      id->second.last_frame = _num_frames;
+      _detections[i].id() = id->second.id;
+
+      _bounding_boxes[i] = cached.box;
+      _box_table.add(_bounding_boxes[i].first,
+                     _bounding_boxes[i].second,
+                     _box_margin,
+                     model.type().substr(0,model.type().find_first_of("_")));
       _detections[i].type() = model.type();
     }
+
+    //forget the models that left the view
+    for(ModelTable::iterator it = _model_table.begin(); it != _model_table.end();){
+      if(it->second.last_frame != _num_frames)
+        _model_table.erase(it++);
+      else
+        ++it;
+    }
+
+    //and, a while later, their ids
+    if(_instance_id_lifetime){
+      for(InstanceIdTable::iterator it = _instance_ids.begin(); it != _instance_ids.end();){
+        if(_num_frames-it->second.last_frame > _instance_id_lifetime)
+          _instance_ids.erase(it++);
+        else
+          ++it;
+      }
+    }
+
+    resetDetections();
   }
 
-  void ObjectDetector::computeImageBoundingBoxes(){
+  void ObjectDetector::resetDetections(){
+    const int num_bins = std::max(1,(int)std::ceil((_max_distance-_min_distance)/_depth_histogram_resolution));
+    const bool release = (_bounded_memory && _memory_configuration_changed);
+    _memory_configuration_changed = false;
+    for(size_t i=0; i < _detections.size(); ++i){
+      //keeps the pixel buffers, which come from an older frame when snapshots are published
+      _detections[i].clear();
+      if(release)
+        _detections[i].releasePixels();
+
+      DetectionAccumulator &accumulator = _accumulators[i];
+      accumulator.r_sum = 0;
+      accumulator.c_sum = 0;
+      accumulator.num_points = 0;
+      accumulator.depth_sum = 0;
+      accumulator.min_point = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+      accumulator.max_point = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+      accumulator.depth_histogram.assign(num_bins,0);
+    }
 
-    for(int r=0; r<_rows; ++r){
-      const cv::Vec3f* point_ptr=_points_image.ptr<const cv::Vec3f>(r);
-      for(int c=0; c<_cols; ++c, ++point_ptr){
-        const cv::Vec3f& p = *point_ptr;
+    //keeps its capacity, so after the first frames points are appended without reallocating;
+    //bounded memory without a cap only grows it to the largest frame
+    _cloud.points.clear();
+    if(release)
+      _cloud.points.shrink_to_fit();
+    if(_compute_cloud){
+      if(_max_cloud_points)
+        _cloud.points.reserve(std::min(_max_cloud_points,_rows*_cols));
+      else if(!_bounded_memory)
+        _cloud.points.reserve(_rows*_cols);
+    }
+  }
+
+  void ObjectDetector::useMask(int j){
+    //points of box j project inside its projected box; at coarse levels the pixels are
+    //given one more coarse pixel, at full resolution the blocks of the upsampled pixels
+    const int stride = pyramidStride();
+    const cv::Rect box = projectBox(j);
+    cv::Rect window;
+    if(_pixel_stride > 1){
+      const int rows = (_rows+stride-1)/stride;
+      const int cols = (_cols+stride-1)/stride;
+      const int c_begin = box.x/stride-1;
+      const int r_begin = box.y/stride-1;
+      window = cv::Rect(c_begin,r_begin,
+                        (box.br().x+stride-1)/stride+1-c_begin,
+                        (box.br().y+stride-1)/stride+1-r_begin) & cv::Rect(0,0,cols,rows);
+    } else {
+      window = cv::Rect(box.x-stride,box.y-stride,box.width+2*stride,box.height+2*stride) & cv::Rect(0,0,_cols,_rows);
+    }
+    _detections[j].setMaskWindow(Eigen::Vector2i(window.x,window.y),window.height,window.width);
+  }
+
+  void ObjectDetector::computeDetectionStatistics(){
+    for(size_t i=0; i < _detections.size(); ++i){
+      Detection &detection = _detections[i];
+      const DetectionAccumulator &accumulator = _accumulators[i];
+
+      const int num_pixels = detection.numPixels();
+      if(!num_pixels)
+        continue;
+      detection.centroid() = Eigen::Vector2f(accumulator.r_sum/num_pixels,accumulator.c_sum/num_pixels);
+
+      if(!accumulator.num_points)
+        continue;
+      detection.meanDepth() = accumulator.depth_sum/accumulator.num_points;
+      detection.minPoint() = accumulator.min_point;
+      detection.maxPoint() = accumulator.max_point;
+
+      //center of the bin holding the middle point
+      const std::vector<int> &histogram = accumulator.depth_histogram;
+      int count = 0;
+      size_t bin = 0;
+      while(bin < histogram.size()-1 && 2*(count+histogram[bin]) < accumulator.num_points)
+        count += histogram[bin++];
+      detection.medianDepth() = _min_distance+(bin+0.5f)*_depth_histogram_resolution;
+    }
+  }
+
+  template <int TileSize, typename PointStorage>
+  void ObjectDetector::computeImageBoundingBoxes(const PointStorage &points){
+    int num_boxes=_box_table.size();
+    int num_tiles=_tiles.size();
+    _tile_statistics.assign(num_tiles,TileStatistics());
+
+    std::vector<int> candidates;
+    candidates.reserve(num_boxes);
+
+    for(int t=0; t<num_tiles; ++t){
+      const ImageTile &tile = _tiles[t];
+      TileStatistics &statistics = _tile_statistics[t];
+      if(!tile.num_valid)
+        continue;
+
+      //keep only the boxes that overlap the points of this tile, in their original order
+      candidates.clear();
+      for(int j=0; j < num_boxes; ++j)
+        if(overlaps(tile,j))
+          candidates.push_back(j);
+      statistics.num_candidates = candidates.size();
+      if(candidates.empty())
+        continue;
+      _tile_box_table.select(_box_table,candidates);
+
+      //constant trip counts when the tiles are never clipped
+      const int r_end = TileSize ? tile.r_min+TileSize : tile.r_max+1;
+      const int c_end = TileSize ? tile.c_min+TileSize : tile.c_max+1;
+      cv::Vec3f p;
+      for(int r=tile.r_min; r<r_end; ++r){
+        const typename PointStorage::Row row = points.row(r);
+        for(int c=tile.c_min; c<c_end; ++c){
+          if(!row.point(p,c))
+            continue;
+
+          const int k = _first_hit(_tile_box_table,p[0],p[1],p[2]);
+          if(k < 0)
+            continue;
+
+          addPixel(candidates[k],r,c,p);
+          ++statistics.num_hits;
+        }
+      }
+    }
+  }
+
+  template <typename PointStorage>
+  void ObjectDetector::computeImageBoundingBoxesRasterized(const PointStorage &points){
+    const int rows = points.rows();
+    const int cols = points.cols();
+    const Eigen::Matrix3f &K = _level_K;
+
+    _id_image.create(rows,cols);
+    _id_image = -1;
+
+    std::vector<Eigen::Vector2f> corners(8);
+    std::vector<Eigen::Vector2f> hull;
+
+    for(int j=0; j < _box_table.size(); ++j){
+      const float x[2] = {_box_table.xMin()[j],_box_table.xMax()[j]};
+      const float y[2] = {_box_table.yMin()[j],_box_table.yMax()[j]};
+      const float z[2] = {_box_table.zMin()[j],_box_table.zMax()[j]};
+
+      //boxes entirely behind the camera can't be seen
+      if(z[1] <= 0)
+        continue;
+
+      //project the corners; boxes reaching the image plane cover the whole image
+      bool full_image = (z[0] < 1e-3f);
+      for(int i=0; i<8 && !full_image; ++i){
+        const Eigen::Vector3f corner(x[i&1],y[(i>>1)&1],z[(i>>2)&1]);
+        const Eigen::Vector3f projection = K*corner;
+        corners[i] = projection.head<2>()/projection.z();
+      }
+
+      int r_begin = 0;
+      int r_end = rows-1;
+      float v_min = 0, v_max = 0;
+      if(!full_image){
+        convexHull(hull,corners);
+        v_min = v_max = hull[0].y();
+        for(size_t i=1; i<hull.size(); ++i){
+          v_min = std::min(v_min,hull[i].y());
+          v_max = std::max(v_max,hull[i].y());
+        }
+        r_begin = std::max(0,(int)std::floor(v_min)-1);
+        r_end = std::min(rows-1,(int)std::ceil(v_max)+1);
+      }
 
-        if(cv::norm(p) < 1e-3)
+      for(int r=r_begin; r<=r_end; ++r){
+        int c_begin = 0;
+        int c_end = cols-1;
+        if(!full_image){
+          //span of the row inside the projected hull, one pixel wider on each side
+          const float v = std::max(v_min,std::min((float)r,v_max));
+          float u_min = std::numeric_limits<float>::max();
+          float u_max = -std::numeric_limits<float>::max();
+          const int num_vertices = hull.size();
+          for(int i=0; i<num_vertices; ++i){
+            const Eigen::Vector2f &a = hull[i];
+            const Eigen::Vector2f &b = hull[(i+1)%num_vertices];
+            if(v < std::min(a.y(),b.y()) || v > std::max(a.y(),b.y()))
+              continue;
+            if(a.y() == b.y()){
+              u_min = std::min(u_min,std::min(a.x(),b.x()));
+              u_max = std::max(u_max,std::max(a.x(),b.x()));
+            } else {
+              const float u = a.x()+(v-a.y())*(b.x()-a.x())/(b.y()-a.y());
+              u_min = std::min(u_min,u);
+              u_max = std::max(u_max,u);
+            }
+          }
+          if(u_min > u_max)
+            continue;
+          c_begin = std::max(0,(int)std::floor(u_min)-1);
+          c_end = std::min(cols-1,(int)std::ceil(u_max)+1);
+        }
+
+        const typename PointStorage::Row row = points.row(r);
+        int* id_ptr = _id_image.ptr<int>(r)+c_begin;
+        cv::Vec3f p;
+        for(int c=c_begin; c<=c_end; ++c, ++id_ptr){
+          //pixels already claimed by an earlier box keep their label
+          if(*id_ptr >= 0)
+            continue;
+
+          if(!row.point(p,c))
+            continue;
+
+          if(contains(p,j)){
+            *id_ptr = j;
+            addPixel(j,r,c,p);
+          }
+        }
+      }
+    }
+  }
+
+  cv::Rect ObjectDetector::projectBox(int j) const {
+    const float x[2] = {_box_table.xMin()[j],_box_table.xMax()[j]};
+    const float y[2] = {_box_table.yMin()[j],_box_table.yMax()[j]};
+    const float z[2] = {_box_table.zMin()[j],_box_table.zMax()[j]};
+    const cv::Rect image(0,0,_cols,_rows);
+    if(z[1] <= 0)
+      return cv::Rect();
+    if(z[0] < 1e-3f)
+      return image;
+
+    //bounds of the projected corners, one pixel wider on each side like the rasterized spans
+    float u_min = std::numeric_limits<float>::max(), v_min = u_min;
+    float u_max = -std::numeric_limits<float>::max(), v_max = u_max;
+    for(int i=0; i<8; ++i){
+      const Eigen::Vector3f projection = _K*Eigen::Vector3f(x[i&1],y[(i>>1)&1],z[(i>>2)&1]);
+      const float u = projection.x()/projection.z();
+      const float v = projection.y()/projection.z();
+      u_min = std::min(u_min,u);
+      u_max = std::max(u_max,u);
+      v_min = std::min(v_min,v);
+      v_max = std::max(v_max,v);
+    }
+    const int c_begin = (int)std::floor(u_min)-1;
+    const int r_begin = (int)std::floor(v_min)-1;
+    return cv::Rect(c_begin,r_begin,(int)std::ceil(u_max)+2-c_begin,(int)std::ceil(v_max)+2-r_begin) & image;
+  }
+
+  bool ObjectDetector::prepareIncremental(){
+    if(_previous_labels.rows != _rows ||
+       _previous_labels.cols != _cols ||
+       _previous_depths.rows != _rows ||
+       _previous_depths.cols != _cols ||
+       _previous_K != _K)
+      return false;
+
+    //previous models are matched by type in order. The kept models must be in the same
+    //order and no model may appear, so that the boxes deciding a kept label are the same
+    //boxes, each moved by at most the motion of that label; a removed model only drops labels
+    const int num_previous = _previous_types.size();
+    const int num_detections = _detections.size();
+    _previous_to_current.assign(num_previous,-1);
+    int last_kept = -1;
+    float max_motion = 0;
+    for(int j=0; j < num_detections; ++j){
+      int k = 0;
+      while(k < num_previous && (_previous_to_current[k] >= 0 || _previous_types[k] != _detections[j].type()))
+        ++k;
+      if(k == num_previous || k < last_kept)
+        return false;
+
+      //larger image motions would test most pixels again anyway
+      const cv::Rect rect = projectBox(j);
+      const cv::Rect &previous_rect = _previous_rects[k];
+      const int shift = std::max(std::max(std::abs(rect.x-previous_rect.x),std::abs(rect.y-previous_rect.y)),
+                                 std::max(std::abs(rect.br().x-previous_rect.br().x),std::abs(rect.br().y-previous_rect.br().y)));
+      if(shift > _incremental_band)
+        return false;
+
+      const BoxTable &previous = _previous_box_table;
+      const float motion = std::max(std::max(std::max(std::abs(_box_table.xMin()[j]-previous.xMin()[k]),std::abs(_box_table.xMax()[j]-previous.xMax()[k])),
+                                             std::max(std::abs(_box_table.yMin()[j]-previous.yMin()[k]),std::abs(_box_table.yMax()[j]-previous.yMax()[k]))),
+                                    std::max(std::abs(_box_table.zMin()[j]-previous.zMin()[k]),std::abs(_box_table.zMax()[j]-previous.zMax()[k])));
+      max_motion = std::max(max_motion,motion);
+      _previous_to_current[k] = j;
+      last_kept = k;
+
+      //k >= j, so the motion of label k is read before it's overwritten
+      _box_motions[j] = _box_motions[k]+max_motion;
+    }
+    _box_motions.resize(num_detections);
+
+    //the slacks are floats offset by the motion, keep it small enough for their precision
+    _box_motion += max_motion;
+    return _box_motion < 10.0;
+  }
+
+  template <typename PointStorage>
+  void ObjectDetector::computeImageBoundingBoxesIncremental(const PointStorage &points){
+    if(_retest_all){
+      _previous_depths.create(_rows,_cols);
+      _box_motions.assign(_detections.size(),0);
+      _box_motion = 0;
+    }
+    _num_retested_pixels = 0;
+    const float box_motion = _box_motion;
+    //covers the rounding of the points, the box tests and the motion sums
+    const float epsilon = 1e-4f;
+    cv::Vec3f p;
+    for(int r=0; r<_rows; ++r){
+      const typename PointStorage::Row row = points.row(r);
+      const int* labels = _previous_labels.ptr<const int>(r);
+      cv::Vec2f* depths = _previous_depths.ptr<cv::Vec2f>(r);
+      for(int c=0; c<_cols; ++c){
+        cv::Vec2f &depth = depths[c];
+        if(!row.point(p,c)){
+          depth[1] = -1;
           continue;
+        }
 
-        const Eigen::Vector3f point(p[0],p[1],p[2]);
+        //with the same K, the point moves along its ray by the depth change times
+        //max(1,|x/z|,|y/z|), which the slack is divided by
+        if(!_retest_all){
+          const int label = labels[c];
+          const int j = label >= 0 ? _previous_to_current[label] : -1;
+          if(label < 0 || j >= 0){
+            const float motion = j >= 0 ? (float)_box_motions[j] : box_motion;
+            if(std::abs(p[2]-depth[0])+motion < depth[1]){
+              if(j >= 0)
+                addPixel(j,r,c,p);
+              continue;
+            }
+          }
+          ++_num_retested_pixels;
+        }
+
+        float clearance = std::numeric_limits<float>::max();
+        const int j = firstHitClearance(p,clearance);
+        const float motion = j >= 0 ? (float)_box_motions[j] : box_motion;
+        if(j >= 0)
+          addPixel(j,r,c,p);
+        depth[0] = p[2];
+        depth[1] = clearance*(p[2]/std::max(p[2],std::max(std::abs(p[0]),std::abs(p[1]))))+motion-epsilon;
+      }
+    }
+    if(_retest_all)
+      _num_retested_pixels = -1;
+  }
 
-        for(int j=0; j < _bounding_boxes.size(); ++j){
-          int &r_min = _detections[j].topLeft().x();
-          int &c_min = _detections[j].topLeft().y();
-          int &r_max = _detections[j].bottomRight().x();
-          int &c_max = _detections[j].bottomRight().y();
+  void ObjectDetector::storeLabels(){
+    _previous_labels.create(_rows,_cols);
+    _previous_labels = -1;
+    const int num_detections = _detections.size();
+    _previous_types.resize(num_detections);
+    _previous_rects.resize(num_detections);
+    for(int j=0; j < num_detections; ++j){
+      IntImage &labels = _previous_labels;
+      _detections[j].forEachPixel([&labels,j](int r, int c){labels(r,c) = j;});
+      _previous_types[j] = _detections[j].type();
+      _previous_rects[j] = projectBox(j);
+    }
+    _previous_box_table = _box_table;
+    _previous_K = _K;
+  }
 
-          if(inRange(point,_bounding_boxes[j])){
-            if(r < r_min)
-              r_min = r;
-            if(r > r_max)
-              r_max = r;
+  int ObjectDetector::firstHit(const Eigen::Vector3f &point){
+    return _first_hit(_box_table,point.x(),point.y(),point.z());
+  }
 
-            if(c < c_min)
-              c_min = c;
-            if(c > c_max)
-              c_max = c;
+  void ObjectDetector::upsampleDetections(){
+    const int stride = pyramidStride();
+    const int coarse_rows = (_rows+stride-1)/stride;
+    const int coarse_cols = (_cols+stride-1)/stride;
+    const Eigen::Matrix3f inverse_K = _K.inverse();
+
+    //coarse label map, -1 where no box was hit
+    IntImage labels(coarse_rows,coarse_cols);
+    labels = -1;
+    for(int i=0; i < (int)_detections.size(); ++i)
+      _detections[i].forEachPixel([&labels,i](int r, int c){labels(r,c) = i;});
+    resetDetections();
+    _pixel_stride = 1;
+
+    for(int r=0; r<coarse_rows; ++r){
+      for(int c=0; c<coarse_cols; ++c){
+        const int label = labels(r,c);
+
+        //a coarse pixel lies on a boundary if any of its 4-neighbours has a different label
+        bool boundary = false;
+        if(_refine_boundaries)
+          boundary = ((r > 0 && labels(r-1,c) != label) ||
+                      (r < coarse_rows-1 && labels(r+1,c) != label) ||
+                      (c > 0 && labels(r,c-1) != label) ||
+                      (c < coarse_cols-1 && labels(r,c+1) != label));
+
+        if(label < 0 && !boundary)
+          continue;
 
-            _detections[j].pixels().push_back(Eigen::Vector2i(c,r));
-            break;
+        const int r_end = std::min((r+1)*stride,_rows);
+        const int c_end = std::min((c+1)*stride,_cols);
+        for(int rr=r*stride; rr<r_end; ++rr){
+          for(int cc=c*stride; cc<c_end; ++cc){
+            const float d = _depth_image(rr,cc);
+            const bool valid = (d <= _max_distance && d >= _min_distance);
+            Eigen::Vector3f point = Eigen::Vector3f::Zero();
+            if(valid)
+              point = inverse_K*Eigen::Vector3f(cc,rr,1)*d;
+            const cv::Vec3f p(point.x(),point.y(),point.z());
+
+            if(!boundary){
+              addPixel(label,rr,cc,p);
+              continue;
+            }
+
+            //boundary blocks are re-tested at full resolution
+            if(!valid)
+              continue;
+            const int j = firstHit(point);
+            if(j >= 0)
+              addPixel(j,rr,cc,p);
           }
         }
       }
     }
   }
 
+  template <typename PointStorage>
+  void ObjectDetector::runEngine(const PointStorage &points){
+    _fixed_size_frame = false;
+    if(_incremental_frame){
+      double cv_ibb_time = (double)cv::getTickCount();
+      computeImageBoundingBoxesIncremental(points);
+      if(_verbose)
+        printf("Computing IBB (incremental, %d/%d pixels re-tested) took: %f\n",
+               _retest_all ? _rows*_cols : _num_retested_pixels,_rows*_cols,
+               ((double)cv::getTickCount() - cv_ibb_time)/cv::getTickFrequency());
+      return;
+    }
+
+    //coarse levels have no slack for the next incremental frame
+    if(_incremental)
+      _previous_depths.release();
+
+    if(_engine == RasterizationEngine){
+      //Compute image bounding boxes by scan-converting the projected boxes
+      double cv_ibb_time = (double)cv::getTickCount();
+      computeImageBoundingBoxesRasterized(points);
+      if(_verbose)
+        printf("Computing IBB (rasterized) took: %f\n",((double)cv::getTickCount() - cv_ibb_time)/cv::getTickFrequency());
+      return;
+    }
+
+    _fixed_size_frame = (_fixed_size_core && _tile_size == SensorTileGrid::tile_size &&
+                         points.rows() == SensorTileGrid::rows && points.cols() == SensorTileGrid::cols);
+
+    //Compute per-tile point bounds
+    double cv_tiles_time = (double)cv::getTickCount();
+    if(_fixed_size_frame)
+      computeFixedImageTiles<SensorTileGrid>(_tiles,points);
+    else
+      computeImageTiles(_tiles,points,_tile_size);
+    if(_verbose)
+      printf("Computing tiles%s took: %f\n",_fixed_size_frame ? " (fixed size)" : "",
+             ((double)cv::getTickCount() - cv_tiles_time)/cv::getTickFrequency());
+
+    //Compute image bounding boxes
+    double cv_ibb_time = (double)cv::getTickCount();
+    if(_fixed_size_frame)
+      computeImageBoundingBoxes<SensorTileGrid::tile_size>(points);
+    else
+      computeImageBoundingBoxes<0>(points);
+    if(_verbose)
+      printf("Computing IBB took: %f\n",((double)cv::getTickCount() - cv_ibb_time)/cv::getTickFrequency());
+
+    if(_verbose){
+      int culled_tiles=0;
+      for(size_t i=0; i<_tile_statistics.size(); ++i)
+        if(!_tile_statistics[i].num_candidates)
+          ++culled_tiles;
+      printf("Culled %d/%d tiles\n",culled_tiles,(int)_tile_statistics.size());
+    }
+  }
+
   void ObjectDetector::compute(){
     //Compute world bounding boxes
     double cv_wbb_time = (double)cv::getTickCount();
     computeWorldBoundingBoxes();
-    printf("Computing WBB took: %f\n",((double)cv::getTickCount() - cv_wbb_time)/cv::getTickFrequency());
+    if(_verbose)
+      printf("Computing WBB took: %f\n",((double)cv::getTickCount() - cv_wbb_time)/cv::getTickFrequency());
 
-    for(size_t i=0; i<_bounding_boxes.size(); ++i){
-      std::cerr << _bounding_boxes[i].first.transpose() << " - " << _bounding_boxes[i].first.transpose() << std::endl;
+    if(_verbose){
+      for(size_t i=0; i<_bounding_boxes.size(); ++i){
+        std::cerr << _bounding_boxes[i].first.transpose() << " - " << _bounding_boxes[i].first.transpose() << std::endl;
+      }
+      std::cerr << std::endl;
     }
-    std::cerr << std::endl;
 
-    //Compute image bounding boxes
-    double cv_ibb_time = (double)cv::getTickCount();
-    computeImageBoundingBoxes();
-    printf("Computing IBB took: %f\n",((double)cv::getTickCount() - cv_ibb_time)/cv::getTickFrequency());
+    _incremental_frame = (_incremental && !_pyramid_level);
+    _retest_all = (!_incremental_frame || !prepareIncremental());
+    if(!_incremental_frame)
+      _num_retested_pixels = -1;
+
+    _pixel_stride = pyramidStride();
+
+    if(_compact_points)
+      runEngine(CompactPoints(_raw_depth_image,_rays_image,_depth_lut));
+    else
+      runEngine(Float3Points(_points_image));
+
+    //Bring detections back to full resolution
+    if(pyramidStride() > 1){
+      double cv_upsample_time = (double)cv::getTickCount();
+      upsampleDetections();
+      if(_verbose)
+        printf("Upsampling detections took: %f\n",((double)cv::getTickCount() - cv_upsample_time)/cv::getTickFrequency());
+    }
+
+    computeDetectionStatistics();
+
+    if(_incremental)
+      storeLabels();
+
+    _cloud.width = _cloud.points.size();
+    _cloud.height = 1;
+    _cloud.is_dense = true;
 
     computeLabelImage();
+
+    _last_snapshot = 0;
+    if(_publish_snapshots){
+      double cv_snapshot_time = (double)cv::getTickCount();
+      publishSnapshot();
+      if(_verbose)
+        printf("Publishing snapshot took: %f\n",((double)cv::getTickCount() - cv_snapshot_time)/cv::getTickFrequency());
+    }
+  }
+
+  void ObjectDetector::publishSnapshot(){
+    Snapshot* snapshot = _snapshots.back();
+    if(!snapshot){
+      if(_verbose)
+        std::cerr << "Readers hold all the snapshots, not publishing frame " << _num_frames << std::endl;
+      return;
+    }
+
+    //detections and label image are rebuilt every frame, the next one gets the slot's old ones
+    snapshot->frame = _num_frames;
+    snapshot->stamp = _stamp;
+    snapshot->rows = _rows;
+    snapshot->cols = _cols;
+    snapshot->detections.swap(_detections);
+    snapshot->bounding_boxes = _bounding_boxes;
+    cv::swap(snapshot->label_image,_label_image);
+    _snapshots.publish();
+    _last_snapshot = snapshot;
   }
 
 
+  ObjectDetector::MemoryReport ObjectDetector::memoryReport() const {
+    MemoryReport report;
+    report.push_back(BufferMemory("rgb_image",imageMemory(_rgb_image)));
+    report.push_back(BufferMemory("depth_image",imageMemory(_depth_image)));
+    report.push_back(BufferMemory("depth_lut",_depth_lut.capacity()*sizeof(float)));
+    report.push_back(BufferMemory("directions_image",imageMemory(_directions_image)));
+    report.push_back(BufferMemory("points_image",imageMemory(_points_image)));
+    report.push_back(BufferMemory("raw_depth_image",imageMemory(_raw_depth_image)));
+    report.push_back(BufferMemory("rays_image",imageMemory(_rays_image)));
+    report.push_back(BufferMemory("id_image",imageMemory(_id_image)));
+    report.push_back(BufferMemory("label_image",imageMemory(_label_image)));
+    report.push_back(BufferMemory("previous_labels",imageMemory(_previous_labels)));
+    report.push_back(BufferMemory("previous_depths",imageMemory(_previous_depths)));
+    report.push_back(BufferMemory("tiles",_tiles.capacity()*sizeof(ImageTile)+
+                                  _tile_statistics.capacity()*sizeof(TileStatistics)));
+
+    size_t pixels = 0;
+    size_t histograms = 0;
+    for(size_t i=0; i < _detections.size(); ++i)
+      pixels += _detections[i].pixelMemory();
+    for(size_t i=0; i < _accumulators.size(); ++i)
+      histograms += _accumulators[i].depth_histogram.capacity()*sizeof(int);
+    report.push_back(BufferMemory("detection_pixels",pixels));
+    report.push_back(BufferMemory("depth_histograms",histograms));
+    report.push_back(BufferMemory("cloud",_cloud.points.capacity()*sizeof(pcl::PointXYZL)));
+
+    size_t snapshots = 0;
+    for(int i=0; i < _snapshots.numSlots(); ++i){
+      const Snapshot &snapshot = _snapshots.slot(i);
+      snapshots += imageMemory(snapshot.label_image);
+      for(size_t j=0; j < snapshot.detections.size(); ++j)
+        snapshots += snapshot.detections[j].pixelMemory();
+    }
+    report.push_back(BufferMemory("snapshots",snapshots));
+    return report;
+  }
+
+  size_t ObjectDetector::memoryUsage() const {
+    const MemoryReport report = memoryReport();
+    size_t bytes = 0;
+    for(size_t i=0; i < report.size(); ++i)
+      bytes += report[i].bytes;
+    return bytes;
+  }
+
   cv::Vec3b ObjectDetector::type2color(std::string type){
     int c;
 
@@ -231,17 +935,15 @@ namespace lucrezio_semantic_perception{
   }
 
   void ObjectDetector::computeLabelImage(){
+    //after a snapshot swap the buffer is whatever the slot held
+    _label_image.create(_rows,_cols);
     _label_image=cv::Vec3b(0,0,0);
     for(int i=0; i < _detections.size(); ++i){
       std::string type = _detections[i].type();
       std::string cropped_type = type.substr(0,type.find_first_of("_"));
       cv::Vec3b color = type2color(cropped_type);
-      for(int j=0; j < _detections[i].pixels().size(); ++j){
-        int r = _detections[i].pixels()[j].x();
-        int c = _detections[i].pixels()[j].y();
-
-        _label_image.at<cv::Vec3b>(c,r) = color;
-      }
+      RGBImage &label_image = _label_image;
+      _detections[i].forEachPixel([&label_image,&color](int r, int c){label_image(r,c) = color;});
     }
 
 //    cv::imshow("label_image",_label_image);
@@ -2,10 +2,18 @@
 
 #include "detection.h"
 #include "model.h"
+#include "box_table.h"
+#include "box_test.h"
+#include "scene_io.h"
+#include "snapshot_buffer.h"
 
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <map>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
 
 #include "image_utils.h"
 
@@ -16,13 +24,156 @@ namespace lucrezio_semantic_perception{
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
     typedef std::pair<Eigen::Vector3f,Eigen::Vector3f> BoundingBox3D;
     typedef std::vector<BoundingBox3D> BoundingBox3DVector;
+    //points of all detections in the camera frame, labelled with the instance id of their detection
+    typedef pcl::PointCloud<pcl::PointXYZL> LabeledCloud;
+
+    //running sums behind the statistics of one detection
+    struct DetectionAccumulator{
+      double r_sum;
+      double c_sum;
+      int num_points;
+      double depth_sum;
+      Eigen::Vector3f min_point;
+      Eigen::Vector3f max_point;
+      std::vector<int> depth_histogram;
+    };
+    typedef std::vector<DetectionAccumulator> DetectionAccumulatorVector;
+
+    //per-tile counters of the last computeImageBoundingBoxes call
+    struct TileStatistics{
+      TileStatistics():num_candidates(0),num_hits(0){}
+      int num_candidates;
+      int num_hits;
+    };
+    typedef std::vector<TileStatistics> TileStatisticsVector;
+
+    //world box of a model as computed in a previous frame, with the inputs it came from
+    struct CachedModel{
+      EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+      CachedModel():
+        pose(Eigen::Isometry3f::Identity()),
+        min(Eigen::Vector3f::Zero()),
+        max(Eigen::Vector3f::Zero()),
+        box(Eigen::Vector3f::Zero(),Eigen::Vector3f::Zero()),
+        last_frame(0){}
+      Eigen::Isometry3f pose;
+      Eigen::Vector3f min;
+      Eigen::Vector3f max;
+      BoundingBox3D box;
+      unsigned long last_frame;
+    };
+    //keyed by model name
+    typedef std::map<std::string,CachedModel,std::less<std::string>,
+                     Eigen::aligned_allocator<std::pair<const std::string,CachedModel> > > ModelTable;
+
+    //instance id given to a model name, and the last frame the name was in
+    struct InstanceId{
+      InstanceId(int id_=-1):id(id_),last_frame(0){}
+      int id;
+      unsigned long last_frame;
+    };
+    typedef std::map<std::string,InstanceId> InstanceIdTable;
+
+    //bytes currently allocated by one of the detector's buffers
+    struct BufferMemory{
+      BufferMemory(const std::string &name_="", size_t bytes_=0):name(name_),bytes(bytes_){}
+      std::string name;
+      size_t bytes;
+    };
+    typedef std::vector<BufferMemory> MemoryReport;
 
-    ObjectDetector(){}
+    //results of one frame, as published for other threads
+    struct Snapshot{
+      Snapshot():frame(0),stamp(0),rows(0),cols(0){}
+      //frames computed so far, this one included
+      unsigned long frame;
+      //as given to setStamp
+      double stamp;
+      int rows;
+      int cols;
+      DetectionVector detections;
+      BoundingBox3DVector bounding_boxes;
+      RGBImage label_image;
+    };
+    typedef SnapshotBuffer<Snapshot>::Handle SnapshotHandle;
+
+    //how computeImageBoundingBoxes assigns pixels to boxes:
+    //BackProjectionEngine tests every back-projected point against the boxes of its tile,
+    //RasterizationEngine scan-converts each projected box and tests only the covered pixels
+    enum Engine{BackProjectionEngine, RasterizationEngine};
+
+    //how the box test reads the points of the image:
+    //Float3PointFormat builds a 12 byte per pixel points image,
+    //CompactPointFormat regenerates them from the 16 bit depth and a table of x/z,y/z rays
+    enum PointFormat{Float3PointFormat, CompactPointFormat};
+
+    //the only resolution with a compile-time sized core, the one of our Xtion sensors,
+    //tiled with the default tile size
+    typedef FixedTileGrid<480,640,32> SensorTileGrid;
+
+    ObjectDetector():
+      _verbose(true),
+      _depth_scale(0.001f),
+      _min_distance(0.02f),
+      _max_distance(8.0f),
+      _directions_K(Eigen::Matrix3f::Zero()),
+      _tile_size(32),
+      _pyramid_level(0),
+      _refine_boundaries(true),
+      _engine(BackProjectionEngine),
+      _point_format(Float3PointFormat),
+      _compact_points(false),
+      _rays_K(Eigen::Matrix3f::Zero()),
+      _fixed_size_core(false),
+      _fixed_size_frame(false),
+      _next_instance_id(0),
+      _instance_id_lifetime(300),
+      _num_frames(0),
+      _num_model_hits(0),
+      _num_model_misses(0),
+      _cached_rgbd_camera_transform(Eigen::Isometry3f::Identity()),
+      _cached_logical_camera_transform(Eigen::Isometry3f::Identity()),
+      _logical_to_rgbd_transform(Eigen::Isometry3f::Identity()),
+      _box_margin(0.01),
+      _first_hit(selectFirstHitFunction()),
+      _depth_histogram_resolution(0.01f),
+      _compute_cloud(false),
+      _bounded_memory(false),
+      _max_detection_pixels(0),
+      _max_cloud_points(0),
+      _memory_configuration_changed(false),
+      _pixel_stride(1),
+      _publish_snapshots(false),
+      _stamp(0),
+      _last_snapshot(0),
+      _incremental(false),
+      _incremental_band(4),
+      _num_retested_pixels(-1),
+      _previous_K(Eigen::Matrix3f::Zero()),
+      _box_motion(0),
+      _incremental_frame(false),
+      _retest_all(true){
+      initializeDepthLUT(_depth_lut,_depth_scale,_min_distance,_max_distance);
+    }
 
     inline void setK(const Eigen::Matrix3f& K_){_K = K_;}
 
+    //raw depth can be 16UC1 (scaled by depthScale) or 32FC1 (meters)
     void setImages(const RGBImage &rgb_image_,
-                   const RawDepthImage &raw_depth_image_);
+                   const cv::Mat &raw_depth_image_);
+
+    //meters per unit of 16UC1 depth images
+    inline void setDepthScale(float depth_scale_){
+      _depth_scale = depth_scale_;
+      initializeDepthLUT(_depth_lut,_depth_scale,_min_distance,_max_distance);
+    }
+
+    //depth values outside [min,max] are treated as invalid
+    inline void setDepthRange(float min_distance_, float max_distance_){
+      _min_distance = min_distance_;
+      _max_distance = max_distance_;
+      initializeDepthLUT(_depth_lut,_depth_scale,_min_distance,_max_distance);
+    }
 
     inline void setCameraTransforms(const Eigen::Isometry3f &rgbd_camera_transform_,
                         const Eigen::Isometry3f &logical_camera_transform_){
@@ -32,50 +183,410 @@ namespace lucrezio_semantic_perception{
 
     inline void setModels(const ModelVector &models_){_models = models_;}
 
-    void readData(char* filename);
+    //sets the models one by one, reusing the storage of the previous frame's models
+    inline void setNumModels(int num_models_){_models.resize(num_models_);}
+    inline void setModel(int i,
+                         const std::string &type_,
+                         const Eigen::Isometry3f &pose_,
+                         const Eigen::Vector3f &min_,
+                         const Eigen::Vector3f &max_){
+      Model &model = _models[i];
+      model.type() = type_;
+      model.pose() = pose_;
+      model.min() = min_;
+      model.max() = max_;
+    }
+
+    inline void setTileSize(int tile_size_){_tile_size = tile_size_;}
+
+    //runs the box test on a depth image subsampled by 2^level (0 is full resolution);
+    //takes effect at the next setImages call
+    inline void setPyramidLevel(int pyramid_level_){_pyramid_level = pyramid_level_;}
+
+    //when running at a coarser level, re-tests the pixels along mask boundaries at full resolution
+    inline void setRefineBoundaries(bool refine_boundaries_){_refine_boundaries = refine_boundaries_;}
+
+    inline void setEngine(Engine engine_){_engine = engine_;}
+
+    //CompactPointFormat only applies to 16UC1 depth, 32FC1 depth always uses Float3PointFormat;
+    //takes effect at the next setImages call
+    inline void setPointFormat(PointFormat point_format_){_point_format = point_format_;}
+
+    //selects the compile-time sized core of the back-projection engine if the sensor is
+    //SensorTileGrid sized, returns true if so. It runs the full resolution frames when the
+    //tile size is SensorTileGrid's; coarser levels and rasterization use the dynamic core,
+    //incremental frames their own test
+    bool setSensorResolution(int rows, int cols);
+
+    //at full resolution, a pixel keeps the label of the previous frame while its depth, and
+    //the faces of the boxes, moved by less than the distance from its point to the boxes that
+    //decided the label, so only a band around the box faces is tested again and the labels are
+    //the same as a full pass. Every pixel is tested again when a model appears or changes order,
+    //when a box moves by more than incrementalBand pixels in the image, and when the size or
+    //K change
+    inline void setIncremental(bool incremental_){_incremental = incremental_;}
+
+    //largest image motion, in pixels, of a box that lets the incremental frame keep labels
+    inline void setIncrementalBand(int incremental_band_){_incremental_band = incremental_band_;}
+
+    //also collects the points of the detections in cloud()
+    inline void setComputeCloud(bool compute_cloud_){
+      _compute_cloud = compute_cloud_;
+      _memory_configuration_changed = true;
+    }
+
+    //releases, at every setImages call, the buffers the current configuration doesn't read
+    //(the rgb image, the other point format, the rasterization and incremental images).
+    //Detection pixels and the cloud are released once, at the next frame after this or
+    //another memory setting changes, then keep their capacity; the cloud isn't reserved
+    //for a whole image
+    inline void setBoundedMemory(bool bounded_memory_){
+      _bounded_memory = bounded_memory_;
+      _memory_configuration_changed = true;
+    }
+
+    //at the end of compute, moves detections and label image, and copies boxes, to a snapshot
+    //that other threads read with snapshot() while the next frames are computed. The accessors
+    //below are only safe from the computing thread
+    inline void setPublishSnapshots(bool publish_snapshots_){_publish_snapshots = publish_snapshots_;}
+
+    //time of the images, in seconds, stored in the snapshot
+    inline void setStamp(double stamp_){_stamp = stamp_;}
+
+    //detections with more pixels than this keep them in a bit mask over their projected box
+    //instead of a list (see Detection::hasMask), 0 for no limit
+    inline void setMaxDetectionPixels(int max_detection_pixels_){
+      _max_detection_pixels = max_detection_pixels_;
+      _memory_configuration_changed = true;
+    }
+
+    //the cloud is reserved for this many points and holds no more, 0 for no limit
+    inline void setMaxCloudPoints(int max_cloud_points_){
+      _max_cloud_points = max_cloud_points_;
+      _memory_configuration_changed = true;
+    }
+
+    //model names not seen for more than this many frames lose their instance id, so the
+    //table holds the names of the last frames only; a name seen again gets a new id, ids are
+    //never reused. 0 keeps every name for the life of the detector
+    inline void setInstanceIdLifetime(unsigned long instance_id_lifetime_){_instance_id_lifetime = instance_id_lifetime_;}
+
+    //forgets every instance id, the next ones start from 0 again
+    inline void resetInstanceIds(){
+      _instance_ids.clear();
+      _next_instance_id = 0;
+    }
+
+    //loads camera transforms and models from a scene file (see SceneParser)
+    bool readData(const std::string &filename);
+
+    //dumps camera transforms and models in the format read by readData
+    bool writeData(const std::string &filename) const;
+
+    //when false, readData and compute don't print poses, boxes and timings
+    inline void setVerbose(bool verbose_){_verbose = verbose_;}
 
     void compute();
 
+    inline bool verbose() const {return _verbose;}
     inline const Eigen::Matrix3f &K() const {return _K;}
+    inline float depthScale() const {return _depth_scale;}
+    inline float minDistance() const {return _min_distance;}
+    inline float maxDistance() const {return _max_distance;}
     inline const Eigen::Isometry3f &rgbdCameraTransform() const {return _rgbd_camera_transform;}
     inline const Eigen::Isometry3f &logicalCameraTransform() const {return _logical_camera_transform;}
     inline const ModelVector &models() const {return _models;}
-    inline const BoundingBox3DVector &boundingBoxes() const {return _bounding_boxes;}
-    inline const DetectionVector &detections() const {return _detections;}
-    inline const RGBImage &labelImage() const {return _label_image;}
+    //world boxes inflated by the test margin
+    inline const BoxTable &boxTable() const {return _box_table;}
+    //results of the last frame, wherever compute left them
+    inline const BoundingBox3DVector &boundingBoxes() const {return _last_snapshot ? _last_snapshot->bounding_boxes : _bounding_boxes;}
+    inline const DetectionVector &detections() const {return _last_snapshot ? _last_snapshot->detections : _detections;}
+    inline const RGBImage &labelImage() const {return _last_snapshot ? _last_snapshot->label_image : _label_image;}
+    inline bool computeCloud() const {return _compute_cloud;}
+    inline const LabeledCloud &cloud() const {return _cloud;}
+    inline int tileSize() const {return _tile_size;}
+    inline int pyramidLevel() const {return _pyramid_level;}
+    inline int pyramidStride() const {return 1 << _pyramid_level;}
+    inline bool refineBoundaries() const {return _refine_boundaries;}
+    inline Engine engine() const {return _engine;}
+    inline PointFormat pointFormat() const {return _point_format;}
+    //true if the last setImages call set up compact points
+    inline bool compactPoints() const {return _compact_points;}
+    inline bool fixedSizeCore() const {return _fixed_size_core;}
+    //true if the last frame ran on the compile-time sized core
+    inline bool fixedSizeFrame() const {return _fixed_size_frame;}
+    inline const ImageTileVector &tiles() const {return _tiles;}
+    //instance id of every model name seen in the last instanceIdLifetime frames, see Detection::id
+    inline const InstanceIdTable &instanceIds() const {return _instance_ids;}
+    inline unsigned long instanceIdLifetime() const {return _instance_id_lifetime;}
+    inline bool incremental() const {return _incremental;}
+    inline int incrementalBand() const {return _incremental_band;}
+    //pixels tested by the last frame if it kept the labels of the others, -1 otherwise
+    inline int numRetestedPixels() const {return _num_retested_pixels;}
+    //world boxes kept across frames, and how many models found theirs there in computeWorldBoundingBoxes
+    inline const ModelTable &modelTable() const {return _model_table;}
+    inline unsigned long numModelHits() const {return _num_model_hits;}
+    inline unsigned long numModelMisses() const {return _num_model_misses;}
+    inline const TileStatisticsVector &tileStatistics() const {return _tile_statistics;}
+    inline bool boundedMemory() const {return _bounded_memory;}
+    inline bool publishSnapshots() const {return _publish_snapshots;}
+
+    //latest published snapshot, from any thread, invalid until the first one; the snapshot
+    //stays as it is while the handle is kept, compute never waits for readers
+    inline SnapshotHandle snapshot() const {return _snapshots.latest();}
+    inline const SnapshotBuffer<Snapshot> &snapshots() const {return _snapshots;}
+    inline int maxDetectionPixels() const {return _max_detection_pixels;}
+    inline int maxCloudPoints() const {return _max_cloud_points;}
+
+    //bytes allocated by each buffer, images shared with the caller included
+    MemoryReport memoryReport() const;
+    //sum of the report
+    size_t memoryUsage() const;
 
   protected:
+    bool _verbose;
+    SceneParser _scene_parser;
+
     RGBImage _rgb_image;
-    RawDepthImage _raw_depth_image;
     int _rows;
     int _cols;
     Eigen::Matrix3f _K;
+    //decoded depth at full resolution, only kept to upsample coarse levels
+    FloatImage _depth_image;
+    float _depth_scale;
+    float _min_distance;
+    float _max_distance;
+    DepthLUT _depth_lut;
+    //K scaled to the pyramid level
+    Eigen::Matrix3f _level_K;
+    Eigen::Matrix3f _directions_K;
+    Float3Image _directions_image;
     Float3Image _points_image;
 
+    int _tile_size;
+    ImageTileVector _tiles;
+    TileStatisticsVector _tile_statistics;
+
+    int _pyramid_level;
+    bool _refine_boundaries;
+
+    Engine _engine;
+    //index of the box owning each pixel, filled by the rasterization engine
+    IntImage _id_image;
+
+    PointFormat _point_format;
+    bool _compact_points;
+    //raw depth at the pyramid level and its rays, read instead of _points_image by compact points
+    RawDepthImage _raw_depth_image;
+    Eigen::Matrix3f _rays_K;
+    Float2Image _rays_image;
+
+    bool _fixed_size_core;
+    bool _fixed_size_frame;
+
     Eigen::Isometry3f _rgbd_camera_transform;
     Eigen::Isometry3f _logical_camera_transform;
     ModelVector _models;
 
     BoundingBox3DVector _bounding_boxes;
+    InstanceIdTable _instance_ids;
+    int _next_instance_id;
+    unsigned long _instance_id_lifetime;
+    ModelTable _model_table;
+    unsigned long _num_frames;
+    unsigned long _num_model_hits;
+    unsigned long _num_model_misses;
+    //camera transforms the cached boxes were computed with
+    Eigen::Isometry3f _cached_rgbd_camera_transform;
+    Eigen::Isometry3f _cached_logical_camera_transform;
+    Eigen::Isometry3f _logical_to_rgbd_transform;
+    double _box_margin;
+    BoxTable _box_table;
+    BoxTable _tile_box_table;
+    FirstHitFunction _first_hit;
     DetectionVector _detections;
+    float _depth_histogram_resolution;
+    DetectionAccumulatorVector _accumulators;
+
+    bool _compute_cloud;
+    LabeledCloud _cloud;
+
+    bool _bounded_memory;
+    int _max_detection_pixels;
+    int _max_cloud_points;
+    //the buffers an earlier configuration grew are released at the next frame
+    bool _memory_configuration_changed;
+    //stride of the pixel coordinates addPixel gets, the pyramid stride until upsampled
+    int _pixel_stride;
+
+    bool _publish_snapshots;
+    double _stamp;
+    SnapshotBuffer<Snapshot> _snapshots;
+    //the snapshot the last frame's results were moved to, 0 if they weren't; only this
+    //thread writes to it, and not before the next publication
+    const Snapshot* _last_snapshot;
+
+    bool _incremental;
+    int _incremental_band;
+    int _num_retested_pixels;
+    //labels (indices in _detections), types, boxes and projected boxes of the previous frame
+    IntImage _previous_labels;
+    std::vector<std::string> _previous_types;
+    BoxTable _previous_box_table;
+    std::vector<cv::Rect> _previous_rects;
+    Eigen::Matrix3f _previous_K;
+    //for every pixel, the depth it was last tested with and the slack of that test: the pixel
+    //keeps its label while |depth change| + the motion of its label stays below it, -1 for
+    //no point. Only kept at full resolution
+    Float2Image _previous_depths;
+    //sums over the frames, since every pixel was tested, of the largest face motion of the
+    //boxes deciding each label: up to box j for detection j, all of them for no detection
+    std::vector<double> _box_motions;
+    double _box_motion;
+    //current index of each previous detection whose labels are kept, -1 if re-tested
+    std::vector<int> _previous_to_current;
+    //the frame runs computeImageBoundingBoxesIncremental, and tests every pixel in it
+    bool _incremental_frame;
+    bool _retest_all;
 
     RGBImage _label_image;
 
   private:
+    void computeCameraPoints(const cv::Mat &raw_depth_image);
+
+    void computeCompactCameraPoints(const RawDepthImage &raw_depth_image);
+
     void computeWorldBoundingBoxes();
 
-    inline bool inRange(const Eigen::Vector3f &point, const BoundingBox3D &bounding_box){
-      return (point.x() >= bounding_box.first.x()-0.01 && point.x() <= bounding_box.second.x()+0.01 &&
-              point.y() >= bounding_box.first.y()-0.01 && point.y() <= bounding_box.second.y()+0.01 &&
-              point.z() >= bounding_box.first.z()-0.01 && point.z() <= bounding_box.second.z()+0.01);
+    inline bool contains(const cv::Vec3f &p, int j){
+      return (p[0] >= _box_table.xMin()[j] && p[0] <= _box_table.xMax()[j] &&
+              p[1] >= _box_table.yMin()[j] && p[1] <= _box_table.yMax()[j] &&
+              p[2] >= _box_table.zMin()[j] && p[2] <= _box_table.zMax()[j]);
+    }
+
+    //index of the first box containing p, -1 if none; lowers clearance to the distance, along
+    //the axes, from p to the nearest face of the boxes that decided it (all if none)
+    inline int firstHitClearance(const cv::Vec3f &p, float &clearance) const {
+      for(int j=0; j<_box_table.size(); ++j){
+        const float s = std::max(std::max(std::max(_box_table.xMin()[j]-p[0],p[0]-_box_table.xMax()[j]),
+                                          std::max(_box_table.yMin()[j]-p[1],p[1]-_box_table.yMax()[j])),
+                                 std::max(_box_table.zMin()[j]-p[2],p[2]-_box_table.zMax()[j]));
+        if(s <= 0){
+          clearance = std::min(clearance,-s);
+          return j;
+        }
+        clearance = std::min(clearance,s);
+      }
+      return -1;
+    }
+
+    inline bool overlaps(const ImageTile &tile, int j){
+      return (tile.max.x() >= _box_table.xMin()[j] && tile.min.x() <= _box_table.xMax()[j] &&
+              tile.max.y() >= _box_table.yMin()[j] && tile.min.y() <= _box_table.yMax()[j] &&
+              tile.max.z() >= _box_table.zMin()[j] && tile.min.z() <= _box_table.zMax()[j]);
+    }
+
+    //assigns pixel (r,c), whose point is p (zero if unknown), to detection j
+    inline void addPixel(int j, int r, int c, const cv::Vec3f &p){
+      Detection &detection = _detections[j];
+      int &r_min = detection.topLeft().x();
+      int &c_min = detection.topLeft().y();
+      int &r_max = detection.bottomRight().x();
+      int &c_max = detection.bottomRight().y();
+
+      if(r < r_min)
+        r_min = r;
+      if(r > r_max)
+        r_max = r;
+
+      if(c < c_min)
+        c_min = c;
+      if(c > c_max)
+        c_max = c;
+
+      ++detection.numPixels();
+      if(detection.hasMask())
+        detection.addMaskPixel(r,c);
+      else{
+        detection.pixels().push_back(Eigen::Vector2i(c,r));
+        if(_max_detection_pixels && (int)detection.pixels().size() > _max_detection_pixels)
+          useMask(j);
+      }
+
+      DetectionAccumulator &accumulator = _accumulators[j];
+      accumulator.r_sum += r;
+      accumulator.c_sum += c;
+      if(p[2] <= 0)
+        return;
+
+      ++accumulator.num_points;
+      accumulator.depth_sum += p[2];
+      for(int i=0; i<3; ++i){
+        if(p[i] < accumulator.min_point[i])
+          accumulator.min_point[i] = p[i];
+        if(p[i] > accumulator.max_point[i])
+          accumulator.max_point[i] = p[i];
+      }
+      int bin = (p[2]-_min_distance)/_depth_histogram_resolution;
+      bin = std::max(0,std::min(bin,(int)accumulator.depth_histogram.size()-1));
+      ++accumulator.depth_histogram[bin];
+
+      if(_compute_cloud && (!_max_cloud_points || (int)_cloud.points.size() < _max_cloud_points)){
+        pcl::PointXYZL point;
+        point.x = p[0];
+        point.y = p[1];
+        point.z = p[2];
+        point.label = detection.id();
+        _cloud.points.push_back(point);
+      }
     }
 
-    void computeImageBoundingBoxes();
+    //empties the detections, keeping their types, ids and buffers, and their accumulators
+    void resetDetections();
+
+    //moves the pixels of detection j to a mask over the window its pixels can fall in
+    void useMask(int j);
+
+    void releaseUnusedBuffers();
+
+    //PointStorage is Float3Points or CompactPoints, see image_utils.h
+    template <typename PointStorage>
+    void runEngine(const PointStorage &points);
+
+    //TileSize is the size of every tile if known at compile time, 0 otherwise
+    template <int TileSize, typename PointStorage>
+    void computeImageBoundingBoxes(const PointStorage &points);
+
+    template <typename PointStorage>
+    void computeImageBoundingBoxesRasterized(const PointStorage &points);
+
+    //image rectangle covered by box j at full resolution, empty if it can't be seen
+    cv::Rect projectBox(int j) const;
+
+    //fills _previous_to_current and adds the box motion, false if every pixel must be tested
+    bool prepareIncremental();
+
+    //also updates _previous_depths of the tested pixels
+    template <typename PointStorage>
+    void computeImageBoundingBoxesIncremental(const PointStorage &points);
+
+    //keeps this frame's labels for the next incremental frame
+    void storeLabels();
+
+    //index of the first box containing the point, -1 if none
+    int firstHit(const Eigen::Vector3f &point);
+
+    void upsampleDetections();
+
+    void computeDetectionStatistics();
 
     cv::Vec3b type2color(std::string type);
 
     void computeLabelImage();
 
+    //swaps the results with the back snapshot's and publishes it
+    void publishSnapshot();
+
   };
 
 }
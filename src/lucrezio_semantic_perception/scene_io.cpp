@@ -0,0 +1,286 @@
+#include "scene_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace lucrezio_semantic_perception{
+
+  namespace{
+
+    inline bool isSpace(char c){
+      return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool isDigit(char c){
+      return c >= '0' && c <= '9';
+    }
+
+    //decimal number with optional sign, fraction and exponent; advances p past it
+    bool parseNumber(const char *&p, const char *end, float &value){
+      const char *s = p;
+      bool negative = false;
+      if(s < end && (*s == '-' || *s == '+'))
+        negative = (*s++ == '-');
+
+      unsigned long long mantissa = 0;
+      int exponent = 0;
+      int num_digits = 0;
+      int num_significant = 0;
+      for(; s < end && isDigit(*s); ++s, ++num_digits){
+        if(num_significant < 19){
+          mantissa = mantissa*10+(*s-'0');
+          if(mantissa)
+            ++num_significant;
+        } else {
+          ++exponent;
+        }
+      }
+      if(s < end && *s == '.'){
+        for(++s; s < end && isDigit(*s); ++s, ++num_digits){
+          if(num_significant < 19){
+            mantissa = mantissa*10+(*s-'0');
+            if(mantissa)
+              ++num_significant;
+            --exponent;
+          }
+        }
+      }
+      if(!num_digits)
+        return false;
+
+      if(s < end && (*s == 'e' || *s == 'E')){
+        const char *e = s+1;
+        bool negative_exponent = false;
+        if(e < end && (*e == '-' || *e == '+'))
+          negative_exponent = (*e++ == '-');
+        if(e == end || !isDigit(*e))
+          return false;
+        int n = 0;
+        for(; e < end && isDigit(*e); ++e)
+          if(n < 10000)
+            n = n*10+(*e-'0');
+        exponent += negative_exponent ? -n : n;
+        s = e;
+      }
+
+      static const double powers[] = {1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+                                      1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+      double result = (double)mantissa;
+      if(exponent >= 0)
+        result = exponent <= 22 ? result*powers[exponent] : result*std::pow(10.0,exponent);
+      else
+        result = exponent >= -22 ? result/powers[-exponent] : result*std::pow(10.0,exponent);
+
+      value = negative ? -(float)result : (float)result;
+      if(!std::isfinite(value))
+        return false;
+      p = s;
+      return true;
+    }
+
+  }
+
+  bool SceneParser::parseCount(int &count){
+    while(_cursor < _line_end && isSpace(*_cursor))
+      ++_cursor;
+    if(_cursor == _line_end)
+      return fail("too few values");
+    //digits only, a count can't be written as 2e9 or 3.0
+    long long value = 0;
+    const char *digits = _cursor;
+    for(; _cursor < _line_end && isDigit(*_cursor); ++_cursor)
+      if((value = value*10+(*_cursor-'0')) > 0x7fffffff)
+        return fail("model count out of range");
+    if(_cursor == digits || (_cursor < _line_end && !isSpace(*_cursor)))
+      return fail("model count should be a non-negative integer");
+    count = value;
+    return true;
+  }
+
+  SceneParser::SceneParser():
+    _line(0),
+    _cursor(0),
+    _line_end(0),
+    _end(0){}
+
+  bool SceneParser::fail(const char *reason){
+    std::ostringstream stream;
+    stream << "line " << _line << ": " << reason;
+    _error = stream.str();
+    return false;
+  }
+
+  bool SceneParser::nextLine(){
+    if(_line)
+      _cursor = _line_end < _end ? _line_end+1 : _end;
+    ++_line;
+    if(_cursor >= _end)
+      return fail("unexpected end of file");
+    _line_end = static_cast<const char*>(std::memchr(_cursor,'\n',_end-_cursor));
+    if(!_line_end)
+      _line_end = _end;
+    return true;
+  }
+
+  bool SceneParser::parseFloats(float *values, int n){
+    for(int i=0; i<n; ++i){
+      while(_cursor < _line_end && isSpace(*_cursor))
+        ++_cursor;
+      if(_cursor == _line_end)
+        return fail("too few values");
+      if(!parseNumber(_cursor,_line_end,values[i]) || (_cursor < _line_end && !isSpace(*_cursor)))
+        return fail("malformed number");
+    }
+    return true;
+  }
+
+  bool SceneParser::endLine(){
+    while(_cursor < _line_end && isSpace(*_cursor))
+      ++_cursor;
+    if(_cursor != _line_end)
+      return fail("unexpected trailing characters");
+    return true;
+  }
+
+  bool SceneParser::parseTransform(Eigen::Isometry3f &transform){
+    float v[12];
+    if(!parseFloats(v,12))
+      return false;
+    transform.setIdentity();
+    transform.translation() = Eigen::Vector3f(v[0],v[1],v[2]);
+    transform.linear() << v[3],v[4],v[5],v[6],v[7],v[8],v[9],v[10],v[11];
+    return true;
+  }
+
+  bool SceneParser::parse(const char *begin,
+                          const char *end,
+                          Eigen::Isometry3f &rgbd_camera_transform,
+                          Eigen::Isometry3f &logical_camera_transform,
+                          ModelVector &models){
+    _cursor = begin;
+    _line_end = begin;
+    _end = end;
+    _line = 0;
+    _error.clear();
+
+    Eigen::Isometry3f rgbd_transform,logical_transform;
+    if(!nextLine() || !parseTransform(rgbd_transform) || !endLine())
+      return false;
+    if(!nextLine() || !parseTransform(logical_transform) || !endLine())
+      return false;
+
+    int num_models;
+    if(!nextLine() || !parseCount(num_models) || !endLine())
+      return false;
+    //one line per model, checked before allocating them
+    const char *rest = _line_end < _end ? _line_end+1 : _end;
+    const long num_lines = std::count(rest,_end,'\n')+(rest < _end && _end[-1] != '\n');
+    if(num_models > num_lines)
+      return fail("more models than lines left");
+
+    _models.resize(num_models);
+    for(int i=0; i<num_models; ++i){
+      if(!nextLine())
+        return false;
+
+      while(_cursor < _line_end && isSpace(*_cursor))
+        ++_cursor;
+      const char *type_begin = _cursor;
+      while(_cursor < _line_end && !isSpace(*_cursor))
+        ++_cursor;
+      if(_cursor == type_begin)
+        return fail("missing model type");
+
+      Model &model = _models[i];
+      model.type().assign(type_begin,_cursor);
+      if(!parseTransform(model.pose()))
+        return false;
+      float v[6];
+      if(!parseFloats(v,6) || !endLine())
+        return false;
+      model.min() = Eigen::Vector3f(v[0],v[1],v[2]);
+      model.max() = Eigen::Vector3f(v[3],v[4],v[5]);
+    }
+
+    rgbd_camera_transform = rgbd_transform;
+    logical_camera_transform = logical_transform;
+    //hand over the parsed models, keeping the old ones to be overwritten next time
+    models.swap(_models);
+    return true;
+  }
+
+  bool SceneParser::read(const std::string &filename,
+                         Eigen::Isometry3f &rgbd_camera_transform,
+                         Eigen::Isometry3f &logical_camera_transform,
+                         ModelVector &models){
+    _line = 0;
+    FILE *file = std::fopen(filename.c_str(),"rb");
+    if(!file){
+      _error = filename+": "+std::strerror(errno);
+      return false;
+    }
+
+    _buffer.clear();
+    char chunk[65536];
+    size_t n;
+    while((n = std::fread(chunk,1,sizeof(chunk),file)) > 0)
+      _buffer.insert(_buffer.end(),chunk,chunk+n);
+    std::fclose(file);
+
+    const char *begin = _buffer.empty() ? 0 : &_buffer[0];
+    if(parse(begin,begin+_buffer.size(),rgbd_camera_transform,logical_camera_transform,models))
+      return true;
+    _error = filename+": "+_error;
+    return false;
+  }
+
+  namespace{
+
+    void writeTransform(std::ostream &stream, const Eigen::Isometry3f &transform){
+      const Eigen::Vector3f t = transform.translation();
+      const Eigen::Matrix3f R = transform.linear();
+      stream << t.x() << " " << t.y() << " " << t.z();
+      for(int r=0; r<3; ++r)
+        for(int c=0; c<3; ++c)
+          stream << " " << R(r,c);
+    }
+
+  }
+
+  void writeScene(std::ostream &stream,
+                  const Eigen::Isometry3f &rgbd_camera_transform,
+                  const Eigen::Isometry3f &logical_camera_transform,
+                  const ModelVector &models){
+    //9 significant digits are enough to read back the same floats
+    const std::streamsize precision = stream.precision(9);
+    writeTransform(stream,rgbd_camera_transform);
+    stream << "\n";
+    writeTransform(stream,logical_camera_transform);
+    stream << "\n" << models.size() << "\n";
+    for(size_t i=0; i<models.size(); ++i){
+      const Model &model = models[i];
+      stream << model.type() << " ";
+      writeTransform(stream,model.pose());
+      stream << " " << model.min().x() << " " << model.min().y() << " " << model.min().z()
+             << " " << model.max().x() << " " << model.max().y() << " " << model.max().z() << "\n";
+    }
+    stream.precision(precision);
+  }
+
+  bool writeScene(const std::string &filename,
+                  const Eigen::Isometry3f &rgbd_camera_transform,
+                  const Eigen::Isometry3f &logical_camera_transform,
+                  const ModelVector &models){
+    std::ofstream stream(filename.c_str());
+    if(!stream)
+      return false;
+    writeScene(stream,rgbd_camera_transform,logical_camera_transform,models);
+    return bool(stream);
+  }
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "model.h"
+
+namespace lucrezio_semantic_perception{
+
+  //reads the scene text format used by ObjectDetector::readData:
+  //  px py pz r00 r01 r02 r10 r11 r12 r20 r21 r22    rgbd camera transform
+  //  px py pz r00 r01 r02 r10 r11 r12 r20 r21 r22    logical camera transform
+  //  n                                               number of models
+  //  type px py pz r00 ... r22 minx miny minz maxx maxy maxz    (n lines)
+  //Numbers are parsed in place, without streams; buffers and models are reused
+  //across calls, so a parser kept alive does not allocate once warmed up.
+  class SceneParser{
+  public:
+    SceneParser();
+
+    //on failure returns false, leaves the outputs untouched and sets error()
+    bool parse(const char *begin,
+               const char *end,
+               Eigen::Isometry3f &rgbd_camera_transform,
+               Eigen::Isometry3f &logical_camera_transform,
+               ModelVector &models);
+
+    bool read(const std::string &filename,
+              Eigen::Isometry3f &rgbd_camera_transform,
+              Eigen::Isometry3f &logical_camera_transform,
+              ModelVector &models);
+
+    //"line <line>: <reason>" for the last failure, prefixed with "<filename>: " by read;
+    //"<filename>: <system error>" if read couldn't open the file
+    inline const std::string &error() const {return _error;}
+
+  private:
+    std::vector<char> _buffer;
+    ModelVector _models;
+    std::string _error;
+    int _line;
+
+    const char *_cursor;
+    const char *_line_end;
+    const char *_end;
+
+    bool nextLine();
+    bool endLine();
+    bool parseFloats(float *values, int n);
+    bool parseCount(int &count);
+    bool parseTransform(Eigen::Isometry3f &transform);
+    bool fail(const char *reason);
+  };
+
+  //writes a scene that SceneParser reads back
+  void writeScene(std::ostream &stream,
+                  const Eigen::Isometry3f &rgbd_camera_transform,
+                  const Eigen::Isometry3f &logical_camera_transform,
+                  const ModelVector &models);
+
+  bool writeScene(const std::string &filename,
+                  const Eigen::Isometry3f &rgbd_camera_transform,
+                  const Eigen::Isometry3f &logical_camera_transform,
+                  const ModelVector &models);
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace lucrezio_semantic_perception{
+
+  //hands the latest value written by one thread to any number of reader threads
+  //without locks. The writer fills back(), a slot no reader holds, then publishes it;
+  //readers pin the latest published slot with latest() for as long as they keep the
+  //returned Handle, and never see it change. With numSlots slots the writer always
+  //finds a back slot while readers pin at most numSlots-2 of them at once, otherwise
+  //back() returns 0 and that value is not published. Handles must not outlive the buffer.
+  template <typename T>
+  class SnapshotBuffer{
+    struct Slot{
+      Slot():readers(0){}
+      T value;
+      std::atomic<int> readers;
+    };
+
+  public:
+    class Handle{
+    public:
+      Handle():_slot(0){}
+      Handle(const Handle &other_):_slot(other_._slot){
+        if(_slot)
+          ++_slot->readers;
+      }
+      ~Handle(){release();}
+
+      Handle &operator=(const Handle &other_){
+        if(other_._slot)
+          ++other_._slot->readers;
+        release();
+        _slot = other_._slot;
+        return *this;
+      }
+
+      //false before the first publication
+      inline bool valid() const {return _slot != 0;}
+      inline const T &operator*() const {return _slot->value;}
+      inline const T *operator->() const {return &_slot->value;}
+
+      inline void release(){
+        if(_slot)
+          --_slot->readers;
+        _slot = 0;
+      }
+
+    private:
+      friend class SnapshotBuffer;
+      //takes over a reader count already held on the slot
+      explicit Handle(Slot *slot_):_slot(slot_){}
+      Slot *_slot;
+    };
+
+    SnapshotBuffer(int num_slots_ = 3):
+      _num_slots(std::max(2,num_slots_)),
+      _slots(new Slot[_num_slots]),
+      _latest(-1),
+      _back(-1),
+      _num_published(0),
+      _num_skipped(0){}
+
+    //writer side: a slot to fill, the same one until published, 0 if readers pin all the others
+    T *back(){
+      if(_back < 0){
+        const int latest = _latest.load();
+        for(int i=0; i < _num_slots && _back < 0; ++i)
+          if(i != latest && !_slots[i].readers.load())
+            _back = i;
+      }
+      if(_back < 0){
+        ++_num_skipped;
+        return 0;
+      }
+      return &_slots[_back].value;
+    }
+
+    //writer side: makes the slot returned by back() the latest
+    void publish(){
+      if(_back < 0)
+        return;
+      _latest.store(_back);
+      _back = -1;
+      ++_num_published;
+    }
+
+    //reader side, from any thread
+    Handle latest() const {
+      for(;;){
+        const int i = _latest.load();
+        if(i < 0)
+          return Handle();
+        Slot &slot = _slots[i];
+        ++slot.readers;
+        //the writer may have moved on and picked this slot as its back slot since it was
+        //read, in which case it isn't the latest anymore
+        if(_latest.load() == i)
+          return Handle(&slot);
+        --slot.readers;
+      }
+    }
+
+    //writer side: the value held by slot i, published or not
+    inline const T &slot(int i) const {return _slots[i].value;}
+
+    inline int numSlots() const {return _num_slots;}
+    inline unsigned long numPublished() const {return _num_published;}
+    //values not published because no slot was free
+    inline unsigned long numSkipped() const {return _num_skipped;}
+
+  private:
+    const int _num_slots;
+    std::unique_ptr<Slot[]> _slots;
+    std::atomic<int> _latest;
+    int _back;
+    std::atomic<unsigned long> _num_published;
+    std::atomic<unsigned long> _num_skipped;
+  };
+
+}
@@ -0,0 +1,159 @@
+#include "synthetic_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+
+namespace lucrezio_semantic_perception{
+
+  namespace{
+
+    //std distributions are implementation defined, these only rely on the
+    //mt19937 sequence, which the standard fixes, and on basic float arithmetic
+    class Random{
+    public:
+      Random(unsigned int seed):_engine(seed){}
+
+      inline float uniform(float min, float max){
+        return min+(max-min)*((_engine() >> 8)*(1.0f/16777216.0f));
+      }
+
+      //sum of 12 uniforms (Irwin-Hall), close enough to a gaussian for sensor noise and
+      //free of libm calls, whose results may differ between platforms
+      inline float gaussian(float stddev){
+        float sum = 0;
+        for(int i=0; i<12; ++i)
+          sum += uniform(0,1);
+        return stddev*(sum-6);
+      }
+
+      //draws are sequenced explicitly, argument evaluation order is unspecified
+      inline Eigen::Vector3f vector(const Eigen::Vector3f &min, const Eigen::Vector3f &max){
+        Eigen::Vector3f v;
+        for(int i=0; i<3; ++i)
+          v[i] = uniform(min[i],max[i]);
+        return v;
+      }
+
+      inline Eigen::Quaternionf rotation(){
+        Eigen::Vector4f v;
+        for(int i=0; i<4; ++i)
+          v[i] = uniform(-1,1);
+        if(v.norm() < 1e-3f)
+          return Eigen::Quaternionf::Identity();
+        return Eigen::Quaternionf(v.normalized());
+      }
+
+    private:
+      std::mt19937 _engine;
+    };
+
+  }
+
+  SyntheticScene::SyntheticScene(const Parameters &parameters_):
+    _parameters(parameters_){}
+
+  void SyntheticScene::generate(unsigned int seed, int frame){
+    const Parameters &p = _parameters;
+    Random random(seed);
+
+    _K << p.focal_length,0,p.cols/2.0f,
+        0,p.focal_length,p.rows/2.0f,
+        0,0,1;
+
+    //arbitrary camera poses in the world
+    const Eigen::Vector3f world_min(-5,-5,0), world_max(5,5,2);
+    const Eigen::Vector3f rgbd_camera_position = random.vector(world_min,world_max);
+    _rgbd_camera_transform = Eigen::Translation3f(rgbd_camera_position)*random.rotation();
+    const Eigen::Vector3f logical_camera_position = random.vector(world_min,world_max);
+    _logical_camera_transform = Eigen::Translation3f(logical_camera_position)*random.rotation();
+    const Eigen::Isometry3f logical_to_rgbd = _rgbd_camera_transform.inverse()*_logical_camera_transform;
+    const Eigen::Isometry3f rgbd_to_logical = logical_to_rgbd.inverse();
+
+    //models in front of the rgbd camera, expressed in the logical camera frame
+    const char* types[] = {"table","tomato","salt","milk"};
+    const float tan_x = p.cols/(2*p.focal_length);
+    const float tan_y = p.rows/(2*p.focal_length);
+    _models.resize(p.num_models);
+    std::vector<Eigen::Vector3f> surface_min(p.num_models),surface_max(p.num_models);
+    for(int i=0; i<p.num_models; ++i){
+      const float z = random.uniform(p.min_depth,p.max_depth);
+      Eigen::Vector3f center = random.vector(Eigen::Vector3f(-tan_x*z,-tan_y*z,z),Eigen::Vector3f(tan_x*z,tan_y*z,z));
+      if(i & 1)
+        center += frame*p.model_speed*Eigen::Vector3f(1,0,1);
+      const Eigen::Vector3f extent = random.vector(Eigen::Vector3f::Constant(p.min_extent),Eigen::Vector3f::Constant(p.max_extent));
+      const Eigen::Isometry3f pose = rgbd_to_logical*Eigen::Translation3f(center)*random.rotation();
+
+      std::ostringstream type;
+      type << types[i%4] << "_" << i;
+      _models[i] = Model(type.str(),pose,-extent,extent);
+
+      //the box the detector builds: bounds of the two transformed corners
+      const Eigen::Vector3f a = logical_to_rgbd*pose*Eigen::Vector3f(-extent);
+      const Eigen::Vector3f b = logical_to_rgbd*pose*extent;
+      surface_min[i] = a.cwiseMin(b);
+      surface_max[i] = a.cwiseMax(b);
+    }
+
+    //ray cast the uninflated boxes, so that the margin absorbs the noise, then add noise and holes,
+    //drawn again for every frame if asked
+    Random frame_random(seed*2654435761u+frame+1);
+    Random &noise_random = p.noise_per_frame ? frame_random : random;
+    _depth_image.create(p.rows,p.cols);
+    _expected_labels.create(p.rows,p.cols);
+    _rgb_image.create(p.rows,p.cols);
+    _rgb_image = cv::Vec3b(0,0,0);
+    const Eigen::Matrix3f inverse_K = _K.inverse();
+    const float scale = 0.001f;
+    for(int r=0; r<p.rows; ++r){
+      for(int c=0; c<p.cols; ++c){
+        const Eigen::Vector3f direction = inverse_K*Eigen::Vector3f(c,r,1);
+
+        float depth = p.background_depth > 0 ? p.background_depth : 0;
+        for(int i=0; i<p.num_models; ++i){
+          //slab test along the ray, in units of z
+          float t_near = 0, t_far = std::numeric_limits<float>::max();
+          for(int k=0; k<3 && t_near <= t_far; ++k){
+            if(std::fabs(direction[k]) < 1e-9f){
+              if(0 < surface_min[i][k] || 0 > surface_max[i][k])
+                t_near = std::numeric_limits<float>::max();
+              continue;
+            }
+            float t0 = surface_min[i][k]/direction[k];
+            float t1 = surface_max[i][k]/direction[k];
+            if(t0 > t1)
+              std::swap(t0,t1);
+            t_near = std::max(t_near,t0);
+            t_far = std::min(t_far,t1);
+          }
+          if(t_near <= t_far && t_near > 0 && (depth <= 0 || t_near < depth))
+            depth = t_near;
+        }
+
+        unsigned short raw = 0;
+        if(depth > 0 && noise_random.uniform(0,1) >= p.hole_probability)
+          raw = (unsigned short)std::max(0.f,std::min(65535.f,std::floor((depth+noise_random.gaussian(p.noise_stddev))/scale+0.5f)));
+        _depth_image(r,c) = raw;
+
+        //label of the measured point, as the detector would compute it
+        int label = -1;
+        const float measured_depth = scale*raw;
+        if(raw && measured_depth >= p.min_distance && measured_depth <= p.max_distance){
+          //inflated by the margin in double, like the box test has always done
+          const Eigen::Vector3f point = direction*measured_depth;
+          for(int i=0; i<p.num_models && label < 0; ++i){
+            bool inside = true;
+            for(int k=0; k<3 && inside; ++k)
+              inside = (point[k] >= surface_min[i][k]-p.box_margin && point[k] <= surface_max[i][k]+p.box_margin);
+            if(inside)
+              label = i;
+          }
+        }
+        _expected_labels(r,c) = label;
+      }
+    }
+  }
+
+}
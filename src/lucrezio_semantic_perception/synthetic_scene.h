@@ -0,0 +1,90 @@
+#pragma once
+
+#include "model.h"
+#include "image_utils.h"
+
+namespace lucrezio_semantic_perception{
+
+  //procedurally generated, fully deterministic detector input: K, camera transforms,
+  //models and a 16UC1 depth image (mm) rendered from the same boxes the detector
+  //tests against, plus the label every pixel should get.
+  //The same seed and parameters give the same scene on every run. The random draws and
+  //the noise don't depend on the standard library, but the transforms go through Eigen,
+  //so another compiler or instruction set may round a few depths differently.
+  class SyntheticScene{
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+    struct Parameters{
+      Parameters():
+        rows(480),
+        cols(640),
+        focal_length(554.25f),
+        num_models(12),
+        min_extent(0.05f),
+        max_extent(0.6f),
+        min_depth(1.0f),
+        max_depth(6.0f),
+        background_depth(7.5f),
+        noise_stddev(0.002f),
+        hole_probability(0.01f),
+        min_distance(0.02f),
+        max_distance(8.0f),
+        box_margin(0.01),
+        model_speed(0.005f),
+        noise_per_frame(false){}
+
+      int rows;
+      int cols;
+      float focal_length;
+      int num_models;
+      //half size of the models along each axis
+      float min_extent;
+      float max_extent;
+      //range of the model centers along the optical axis
+      float min_depth;
+      float max_depth;
+      //depth of the wall behind the models, 0 for no wall
+      float background_depth;
+      //gaussian depth noise, in meters
+      float noise_stddev;
+      //fraction of pixels with no depth reading
+      float hole_probability;
+      //valid depth range and tolerance of the box test, as in ObjectDetector
+      float min_distance;
+      float max_distance;
+      double box_margin;
+      //motion per frame of the odd models, in meters along the camera x and z axes
+      float model_speed;
+      //draws new noise and holes in every frame of a sequence, like a real sensor
+      bool noise_per_frame;
+    };
+
+    SyntheticScene(const Parameters &parameters_ = Parameters());
+
+    //frame f of a sequence moves the odd models by f*model_speed; everything else is the
+    //same in every frame, noise and holes included unless noise_per_frame is set
+    void generate(unsigned int seed, int frame = 0);
+
+    inline const Parameters &parameters() const {return _parameters;}
+    inline const Eigen::Matrix3f &K() const {return _K;}
+    inline const Eigen::Isometry3f &rgbdCameraTransform() const {return _rgbd_camera_transform;}
+    inline const Eigen::Isometry3f &logicalCameraTransform() const {return _logical_camera_transform;}
+    inline const ModelVector &models() const {return _models;}
+    inline const RawDepthImage &depthImage() const {return _depth_image;}
+    inline const RGBImage &rgbImage() const {return _rgb_image;}
+    //index of the first model whose box holds the measured point of each pixel, -1 if none
+    inline const IntImage &expectedLabels() const {return _expected_labels;}
+
+  private:
+    Parameters _parameters;
+    Eigen::Matrix3f _K;
+    Eigen::Isometry3f _rgbd_camera_transform;
+    Eigen::Isometry3f _logical_camera_transform;
+    ModelVector _models;
+    RawDepthImage _depth_image;
+    RGBImage _rgb_image;
+    IntImage _expected_labels;
+  };
+
+}
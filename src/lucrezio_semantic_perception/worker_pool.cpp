@@ -0,0 +1,98 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+
+namespace lucrezio_semantic_perception{
+
+  WorkerPool::WorkerPool(int num_threads_, int max_queued_):
+    _max_queued(max_queued_),
+    _num_queued(0),
+    _stop(false),
+    _next_queue(0),
+    _num_executed(0),
+    _num_failed(0),
+    _num_borrowed(0),
+    _num_rejected(0){
+    int num_threads = num_threads_;
+    if(num_threads <= 0)
+      num_threads = std::max(1u,std::thread::hardware_concurrency());
+
+    for(int i=0; i<num_threads; ++i)
+      _queues.push_back(std::unique_ptr<TaskQueue>(new TaskQueue));
+    for(int i=0; i<num_threads; ++i)
+      _threads.push_back(std::thread(&WorkerPool::run,this,i));
+  }
+
+  WorkerPool::~WorkerPool(){
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _condition.notify_all();
+    for(size_t i=0; i<_threads.size(); ++i)
+      _threads[i].join();
+  }
+
+  bool WorkerPool::submit(const Task &task_){
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if(_stop || _num_queued >= _max_queued){
+        ++_num_rejected;
+        return false;
+      }
+
+      //counted and pushed under the same lock, a woken thread always finds the task
+      TaskQueue &queue = *_queues[_next_queue++ % _queues.size()];
+      std::lock_guard<std::mutex> queue_lock(queue.mutex);
+      queue.tasks.push_back(task_);
+      ++_num_queued;
+    }
+    _condition.notify_one();
+    return true;
+  }
+
+  bool WorkerPool::pop(int index, Task &task){
+    const int num_queues = _queues.size();
+    for(int i=0; i<num_queues; ++i){
+      TaskQueue &queue = *_queues[(index+i) % num_queues];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if(queue.tasks.empty())
+        continue;
+
+      //oldest first, detector instances requeue their waiting frame at the end
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+      if(i)
+        ++_num_borrowed;
+      return true;
+    }
+    return false;
+  }
+
+  void WorkerPool::run(int index){
+    Task task;
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(;;){
+      //popped and uncounted under the lock submit pushes and counts under, so the count
+      //is always the number of tasks in the deques
+      if(pop(index,task)){
+        --_num_queued;
+        lock.unlock();
+        try{
+          task();
+        } catch(...){
+          ++_num_failed;
+        }
+        task = Task();
+        ++_num_executed;
+        lock.lock();
+        continue;
+      }
+
+      _condition.wait(lock,[this]{return _stop || _num_queued > 0;});
+      if(_stop && !_num_queued)
+        return;
+    }
+  }
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace lucrezio_semantic_perception{
+
+  //sharded FIFO pool: a fixed set of threads, each with its own task deque.
+  //Submitted tasks are spread round-robin over the deques; a thread runs its own
+  //tasks oldest first and takes the oldest task of the next non-empty deque when
+  //it runs dry, so a task that submits again goes behind the ones already queued
+  //and can't starve them. The total number of queued tasks is bounded, submit
+  //refuses tasks beyond it.
+  class WorkerPool{
+  public:
+    typedef std::function<void()> Task;
+
+    //num_threads_ <= 0 uses one thread per hardware core
+    WorkerPool(int num_threads_ = 0, int max_queued_ = 64);
+
+    //runs the tasks still queued, then joins the threads
+    ~WorkerPool();
+
+    //returns false if the pool is full or stopping
+    bool submit(const Task &task_);
+
+    inline int numThreads() const {return _threads.size();}
+    inline int maxQueued() const {return _max_queued;}
+    //tasks run, those that threw included
+    inline unsigned long numExecuted() const {return _num_executed;}
+    //tasks that threw; the exception is dropped and the thread goes on with the next task
+    inline unsigned long numFailed() const {return _num_failed;}
+    //tasks run by a thread other than the one they were queued for
+    inline unsigned long numBorrowed() const {return _num_borrowed;}
+    inline unsigned long numRejected() const {return _num_rejected;}
+
+  private:
+    struct TaskQueue{
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    int _max_queued;
+    std::vector<std::unique_ptr<TaskQueue> > _queues;
+    std::vector<std::thread> _threads;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    int _num_queued;
+    bool _stop;
+
+    std::atomic<unsigned int> _next_queue;
+    std::atomic<unsigned long> _num_executed;
+    std::atomic<unsigned long> _num_failed;
+    std::atomic<unsigned long> _num_borrowed;
+    std::atomic<unsigned long> _num_rejected;
+
+    WorkerPool(const WorkerPool &);
+    WorkerPool &operator=(const WorkerPool &);
+
+    //called with _mutex held, like submit takes it before the queue mutexes
+    bool pop(int index, Task &task);
+
+    void run(int index);
+  };
+
+}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <sstream>
 #include <ros/ros.h>
 #include <sensor_msgs/CameraInfo.h>
 #include <Eigen/Core>
@@ -10,46 +11,167 @@
 #include "tf/tf.h"
 #include "tf/transform_datatypes.h"
 
-#include <message_filters/subscriber.h>
-#include <message_filters/synchronizer.h>
-#include <message_filters/sync_policies/approximate_time.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl_conversions/pcl_conversions.h>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
 #include <lucrezio_semantic_perception/ImageBoundingBoxesArray.h>
+#include <lucrezio_semantic_perception/DetectorStatus.h>
+#include <lucrezio_semantic_perception/QueryObject.h>
 
 #include <lucrezio_semantic_perception/object_detector.h>
+#include <lucrezio_semantic_perception/worker_pool.h>
+#include <lucrezio_semantic_perception/frame_synchronizer.h>
+#include <lucrezio_semantic_perception/frame_scheduler.h>
 
 #include <gazebo_msgs/GetModelState.h>
 
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
 using namespace lucrezio_semantic_perception;
 
 
+//one detector instance, bound to the topics of one camera. The subscriber
+//callbacks only queue the latest frame, the detection runs on a shared pool.
 class ObjectDetectorNode : public ObjectDetector{
 public:
-  ObjectDetectorNode(ros::NodeHandle nh_):
+  ObjectDetectorNode(ros::NodeHandle nh_,
+                     WorkerPool &pool_,
+                     const std::string &namespace_ = "",
+                     const std::string &robot_model_ = "robot"):
     _nh(nh_),
-    _logical_image_sub(_nh,"/gazebo/logical_camera_image",1),
-    _depth_image_sub(_nh,"/camera/depth/image_raw",1),
-    _rgb_image_sub(_nh,"/camera/rgb/image_raw", 1),
-    _synchronizer(FilterSyncPolicy(10),_logical_image_sub,_depth_image_sub,_rgb_image_sub),
-    _it(_nh){
+    _pool(pool_),
+    _namespace(namespace_),
+    _robot_model(robot_model_),
+    _it(_nh),
+    _busy(false),
+    _has_pending(false),
+    _num_dropped(0),
+    _num_stale(0),
+    _num_processed(0),
+    _num_dumped(0){
+
+    //depth decoding
+    ros::NodeHandle private_nh("~");
+    double depth_scale,min_distance,max_distance;
+    private_nh.param("depth_scale",depth_scale,0.001);
+    private_nh.param("min_distance",min_distance,0.02);
+    private_nh.param("max_distance",max_distance,8.0);
+    setDepthScale(depth_scale);
+    setDepthRange(min_distance,max_distance);
+
+    bool publish_cloud;
+    private_nh.param("publish_cloud",publish_cloud,false);
+    setComputeCloud(publish_cloud);
+
+    bool compact_points;
+    private_nh.param("compact_points",compact_points,false);
+    setPointFormat(compact_points ? CompactPointFormat : Float3PointFormat);
+
+    //only the pixels near the faces of the boxes, within the motion of the depth and the
+    //boxes, are tested again
+    bool incremental;
+    int incremental_band;
+    private_nh.param("incremental",incremental,false);
+    private_nh.param("incremental_band",incremental_band,4);
+    setIncremental(incremental);
+    setIncrementalBand(incremental_band);
+
+    //names of models that left the scene are forgotten, a model that comes back gets a new id
+    int instance_id_lifetime;
+    private_nh.param("instance_id_lifetime",instance_id_lifetime,300);
+    setInstanceIdLifetime(std::max(0,instance_id_lifetime));
+
+    //on small boards: release the buffers this configuration doesn't read, keep large
+    //detections in masks and cap the cloud
+    bool bounded_memory;
+    int max_detection_pixels;
+    int max_cloud_points;
+    private_nh.param("bounded_memory",bounded_memory,false);
+    private_nh.param("max_detection_pixels",max_detection_pixels,0);
+    private_nh.param("max_cloud_points",max_cloud_points,0);
+    setBoundedMemory(bounded_memory);
+    setMaxDetectionPixels(std::max(0,max_detection_pixels));
+    setMaxCloudPoints(std::max(0,max_cloud_points));
+
+    //consumers that need the pixels of a few objects ask ~query_object for them, which
+    //answers from the latest frame's snapshot, so that the stream can carry the boxes only
+    bool query_service;
+    private_nh.param("query_service",query_service,true);
+    private_nh.param("stream_pixels",_stream_pixels,true);
+    if(!query_service && !_stream_pixels)
+      ROS_WARN("stream_pixels and query_service are both off, no consumer will get the pixels of the detections");
+    setPublishSnapshots(query_service);
+
+    bool verbose;
+    private_nh.param("verbose",verbose,true);
+    setVerbose(verbose);
+
+    //every processed frame is saved there as a scene readable by readData
+    private_nh.param("scene_dump_directory",_scene_dump_directory,std::string());
 
     _got_info = false;
-    _camera_info_sub = _nh.subscribe("/camera/depth/camera_info",
+    _camera_info_sub = _nh.subscribe(topic("/camera/depth/camera_info"),
                                      1000,
                                      &ObjectDetectorNode::cameraInfoCallback,
                                      this);
 
-    _synchronizer.registerCallback(boost::bind(&ObjectDetectorNode::filterCallback, this, _1, _2, _3));
+    //logical image, depth and rgb are matched on the depth timestamp; frames older than
+    //~max_age seconds are dropped, both here and before being processed
+    double max_skew,max_age;
+    int sync_queue_size;
+    private_nh.param("max_skew",max_skew,0.05);
+    private_nh.param("max_age",max_age,0.5);
+    private_nh.param("sync_queue_size",sync_queue_size,5);
+    _synchronizer.setMaxSkew(max_skew);
+    _synchronizer.setMaxAge(max_age);
+    _synchronizer.setQueueSize(std::max(1,sync_queue_size));
+    _synchronizer.setCallback(boost::bind(&ObjectDetectorNode::filterCallback, this, _1, _2, _3));
+
+    //when the detector can't keep up, process one frame every few or lower the resolution,
+    //to reach ~target_rate processed frames per second within ~latency_budget seconds each
+    double target_rate,latency_budget;
+    int max_pyramid_level,max_frame_skip;
+    private_nh.param("target_rate",target_rate,0.0);
+    private_nh.param("latency_budget",latency_budget,0.0);
+    private_nh.param("max_pyramid_level",max_pyramid_level,1);
+    private_nh.param("max_frame_skip",max_frame_skip,8);
+    _scheduler.setTargetRate(target_rate);
+    _scheduler.setLatencyBudget(latency_budget);
+    _scheduler.setMaxPyramidLevel(max_pyramid_level);
+    _scheduler.setMaxFrameSkip(max_frame_skip);
+
+    _logical_image_sub = _nh.subscribe(topic("/gazebo/logical_camera_image"),
+                                       sync_queue_size,
+                                       &ObjectDetectorNode::logicalImageCallback,
+                                       this);
+    _depth_image_sub = _nh.subscribe(topic("/camera/depth/image_raw"),
+                                     sync_queue_size,
+                                     &ObjectDetectorNode::depthImageCallback,
+                                     this);
+    _rgb_image_sub = _nh.subscribe(topic("/camera/rgb/image_raw"),
+                                   sync_queue_size,
+                                   &ObjectDetectorNode::rgbImageCallback,
+                                   this);
 
     _model_state_client = _nh.serviceClient<gazebo_msgs::GetModelState>("gazebo/get_model_state");
 
-    _image_bounding_boxes_pub = _nh.advertise<lucrezio_semantic_perception::ImageBoundingBoxesArray>("/image_bounding_boxes", 1);
-    _label_image_pub = _it.advertise("/camera/rgb/label_image", 1);
-
-    ROS_INFO("Starting detection simulator node!");
+    _image_bounding_boxes_pub = _nh.advertise<lucrezio_semantic_perception::ImageBoundingBoxesArray>(topic("/image_bounding_boxes"), 1);
+    _label_image_pub = _it.advertise(topic("/camera/rgb/label_image"), 1);
+    if(publish_cloud)
+      _cloud_pub = _nh.advertise<LabeledCloud>(topic("/camera/depth/object_points"), 1);
+    _status_pub = _nh.advertise<lucrezio_semantic_perception::DetectorStatus>(topic("/object_detector/diagnostics"), 1);
+    if(publishSnapshots())
+      _query_object_server = _nh.advertiseService(topic("/object_detector/query_object"),
+                                                  &ObjectDetectorNode::queryObjectCallback,
+                                                  this);
+
+    ROS_INFO("Starting detection simulator for '%s'!",_namespace.c_str());
   }
 
   void cameraInfoCallback(const sensor_msgs::CameraInfo::ConstPtr& camera_info_msg){
@@ -72,120 +194,257 @@ public:
 
     setK(K);
 
+    if(setSensorResolution(camera_info_msg->height,camera_info_msg->width))
+      ROS_INFO("Using the %dx%d detector core",(int)SensorTileGrid::cols,(int)SensorTileGrid::rows);
+
     _got_info = true;
     _camera_info_sub.shutdown();
   }
 
+  //only the header is looked at here, images are decoded on the pool
+  void logicalImageCallback(const lucrezio_simulation_environments::LogicalImage::ConstPtr &logical_image_msg){
+    _synchronizer.addFirst(logical_image_msg,logical_image_msg->header.stamp.toSec(),ros::Time::now().toSec());
+  }
+
+  void depthImageCallback(const sensor_msgs::Image::ConstPtr &depth_image_msg){
+    _synchronizer.addReference(depth_image_msg,depth_image_msg->header.stamp.toSec(),ros::Time::now().toSec());
+  }
+
+  void rgbImageCallback(const sensor_msgs::Image::ConstPtr &rgb_image_msg){
+    _synchronizer.addThird(rgb_image_msg,rgb_image_msg->header.stamp.toSec(),ros::Time::now().toSec());
+  }
+
+  //runs on the spinner thread, while the pool computes the next frames
+  bool queryObjectCallback(lucrezio_semantic_perception::QueryObject::Request &request,
+                           lucrezio_semantic_perception::QueryObject::Response &response){
+    response.found = false;
+    const SnapshotHandle snapshot = ObjectDetector::snapshot();
+    if(!snapshot.valid())
+      return true;
+
+    response.header.frame_id = "camera_depth_optical_frame";
+    response.header.stamp = ros::Time(snapshot->stamp);
+
+    //(row,col), the whole image if no region is given
+    Eigen::Vector2i top_left(0,0);
+    Eigen::Vector2i bottom_right(snapshot->rows-1,snapshot->cols-1);
+    if(request.use_roi){
+      top_left = Eigen::Vector2i((int)request.top_left.r,(int)request.top_left.c).cwiseMax(top_left);
+      bottom_right = Eigen::Vector2i((int)request.bottom_right.r,(int)request.bottom_right.c).cwiseMin(bottom_right);
+    }
+
+    lucrezio_semantic_perception::ImageBoundingBox image_bounding_box;
+    for(size_t i=0; i < snapshot->detections.size(); ++i){
+      const Detection &detection = snapshot->detections[i];
+      const std::string &name = detection.type();
+      if(name != request.name && name.substr(0,name.find_first_of("_")) != request.name)
+        continue;
+      if(fillImageBoundingBox(detection,request.with_pixels,top_left,bottom_right,image_bounding_box))
+        response.image_bounding_boxes.push_back(image_bounding_box);
+    }
+    response.found = !response.image_bounding_boxes.empty();
+    return true;
+  }
+
   void filterCallback(const lucrezio_simulation_environments::LogicalImage::ConstPtr &logical_image_msg,
                       const sensor_msgs::Image::ConstPtr &depth_image_msg,
                       const sensor_msgs::Image::ConstPtr &rgb_image_msg){
 
-    if(_got_info && !logical_image_msg->models.empty()){
-
-      ROS_INFO("--------------------------");
-      ROS_INFO("Executing filter callback!");
-      ROS_INFO("--------------------------");
-      std::cerr << std::endl;
-
-      //Save timestamp
-      _last_timestamp = logical_image_msg->header.stamp;
+    if(!_got_info || logical_image_msg->models.empty())
+      return;
+
+    int pyramid_level;
+    if(!_scheduler.accept(depth_image_msg->header.stamp.toSec(),pyramid_level))
+      return;
+
+    Frame frame;
+    frame.logical_image_msg = logical_image_msg;
+    frame.depth_image_msg = depth_image_msg;
+    frame.rgb_image_msg = rgb_image_msg;
+    frame.pyramid_level = pyramid_level;
+
+    //at most one frame per instance is being processed and one is waiting,
+    //newer frames replace the waiting one
+    std::lock_guard<std::mutex> lock(_frame_mutex);
+    if(_busy){
+      if(_has_pending)
+        ++_num_dropped;
+      _pending_frame = frame;
+      _has_pending = true;
+      return;
+    }
+    if(_pool.submit(boost::bind(&ObjectDetectorNode::processFrame, this, frame)))
+      _busy = true;
+    else
+      ++_num_dropped;
+  }
 
-      //Extract rgb and depth image from ROS messages
-      cv_bridge::CvImageConstPtr rgb_cv_ptr,depth_cv_ptr;
+protected:
+  struct Frame{
+    Frame():pyramid_level(0){}
+    lucrezio_simulation_environments::LogicalImage::ConstPtr logical_image_msg;
+    sensor_msgs::Image::ConstPtr depth_image_msg;
+    sensor_msgs::Image::ConstPtr rgb_image_msg;
+    int pyramid_level;
+  };
+
+  //runs on the pool
+  void processFrame(const Frame &frame){
+    //frames that waited too long in the queue are dropped before decoding them
+    const double age = (ros::Time::now()-frame.depth_image_msg->header.stamp).toSec();
+    if(age > _synchronizer.maxAge()){
+      ++_num_stale;
+    } else {
+      //an exception escaping here would take down the pool thread
       try{
-        rgb_cv_ptr = cv_bridge::toCvShare(rgb_image_msg);
-        depth_cv_ptr = cv_bridge::toCvShare(depth_image_msg);
-      } catch (cv_bridge::Exception& e) {
-        ROS_ERROR("cv_bridge exception: %s", e.what());
-        return;
+        detect(frame.logical_image_msg,frame.depth_image_msg,frame.rgb_image_msg,frame.pyramid_level);
+      } catch (std::exception& e) {
+        ROS_ERROR("Detection failed for '%s': %s", _namespace.c_str(), e.what());
       }
+    }
 
-      cv::Mat rgb_image = rgb_cv_ptr->image.clone();
-      int rgb_rows=rgb_image.rows;
-      int rgb_cols=rgb_image.cols;
-      std::string rgb_type=type2str(rgb_image.type());
-      ROS_INFO("Got %dx%d %s image",rgb_cols,rgb_rows,rgb_type.c_str());
-
-      cv::Mat depth_image = depth_cv_ptr->image.clone();
-      int depth_rows=depth_image.rows;
-      int depth_cols=depth_image.cols;
-      std::string depth_type=type2str(depth_image.type());
-      ROS_INFO("Got %dx%d %s image",depth_cols,depth_rows,depth_type.c_str());
-
-      setImages(rgb_image,depth_image);
-
-      //Listen to camera pose
-      gazebo_msgs::GetModelState model_state;
-      model_state.request.model_name = "robot";
-      tf::StampedTransform robot_pose;
-      if(_model_state_client.call(model_state)){
-        ROS_INFO("Received robot model state!");
-        tf::poseMsgToTF(model_state.response.pose,robot_pose);
-      }else
-        ROS_ERROR("Failed to call service gazebo/get_model_state");
-
-      Eigen::Isometry3f rgbd_camera_pose = Eigen::Isometry3f::Identity();
-      rgbd_camera_pose.translation() = Eigen::Vector3f(0.0,0.0,0.5);
-      rgbd_camera_pose.linear() = Eigen::Quaternionf(0.5,-0.5,0.5,-0.5).toRotationMatrix();
-
-      tf::StampedTransform logical_camera_pose;
-      tf::poseMsgToTF(logical_image_msg->pose,logical_camera_pose);
-
-      setCameraTransforms(tfTransform2eigen(robot_pose)*rgbd_camera_pose,
-                          tfTransform2eigen(logical_camera_pose));
-
-      //process models
-      const std::vector<lucrezio_simulation_environments::Model> &camera_models = logical_image_msg->models;
-      int num_models=camera_models.size();
-      ModelVector models;
-      models.resize(num_models);
-      std::string model_type;
-      tf::StampedTransform model_pose;
-      Eigen::Isometry3f model_transform;
-      Eigen::Vector3f model_min;
-      Eigen::Vector3f model_max;
-      for(size_t i=0; i < num_models; ++i){
-        model_type = camera_models[i].type;
-        tf::poseMsgToTF(camera_models[i].pose,model_pose);
-        model_transform = tfTransform2eigen(model_pose);
-        model_min = Eigen::Vector3f(camera_models[i].min.x,camera_models[i].min.y,camera_models[i].min.z);
-        model_max = Eigen::Vector3f(camera_models[i].max.x,camera_models[i].max.y,camera_models[i].max.z);
-        models[i] = Model(model_type,
-                          model_transform,
-                          model_min,
-                          model_max);
-      }
+    //requeue the waiting frame, if any, behind the other instances' frames
+    std::lock_guard<std::mutex> lock(_frame_mutex);
+    _busy = false;
+    if(!_has_pending)
+      return;
+    _has_pending = false;
+    if(_pool.submit(boost::bind(&ObjectDetectorNode::processFrame, this, _pending_frame)))
+      _busy = true;
+    else
+      ++_num_dropped;
+    _pending_frame = Frame();
+  }
 
-      setModels(models);
+  void detect(const lucrezio_simulation_environments::LogicalImage::ConstPtr &logical_image_msg,
+              const sensor_msgs::Image::ConstPtr &depth_image_msg,
+              const sensor_msgs::Image::ConstPtr &rgb_image_msg,
+              int pyramid_level){
+
+    ROS_INFO("--------------------------");
+    ROS_INFO("Executing filter callback!");
+    ROS_INFO("--------------------------");
+    std::cerr << std::endl;
+
+    //Save timestamp, the depth one is the reference of the synchronizer
+    _last_timestamp = depth_image_msg->header.stamp;
+    setStamp(_last_timestamp.toSec());
+
+    //Extract rgb and depth image from ROS messages
+    cv_bridge::CvImageConstPtr rgb_cv_ptr,depth_cv_ptr;
+    try{
+      rgb_cv_ptr = cv_bridge::toCvShare(rgb_image_msg);
+      depth_cv_ptr = cv_bridge::toCvShare(depth_image_msg);
+    } catch (cv_bridge::Exception& e) {
+      ROS_ERROR("cv_bridge exception: %s", e.what());
+      return;
+    }
 
-      compute();
+    cv::Mat rgb_image = rgb_cv_ptr->image.clone();
+    int rgb_rows=rgb_image.rows;
+    int rgb_cols=rgb_image.cols;
+    std::string rgb_type=type2str(rgb_image.type());
+    ROS_INFO("Got %dx%d %s image",rgb_cols,rgb_rows,rgb_type.c_str());
+
+    //decoded by setImages, no need to copy it here
+    const cv::Mat &depth_image = depth_cv_ptr->image;
+    int depth_rows=depth_image.rows;
+    int depth_cols=depth_image.cols;
+    std::string depth_type=type2str(depth_image.type());
+    ROS_INFO("Got %dx%d %s image",depth_cols,depth_rows,depth_type.c_str());
+
+    //the cost reported to the scheduler covers decoding and detection
+    const ros::WallTime start_time = ros::WallTime::now();
+    setPyramidLevel(pyramid_level);
+    setImages(rgb_image,depth_image);
+
+    //Listen to camera pose
+    gazebo_msgs::GetModelState model_state;
+    model_state.request.model_name = _robot_model;
+    tf::StampedTransform robot_pose;
+    if(_model_state_client.call(model_state)){
+      ROS_INFO("Received robot model state!");
+      tf::poseMsgToTF(model_state.response.pose,robot_pose);
+    }else
+      ROS_ERROR("Failed to call service gazebo/get_model_state");
+
+    Eigen::Isometry3f rgbd_camera_pose = Eigen::Isometry3f::Identity();
+    rgbd_camera_pose.translation() = Eigen::Vector3f(0.0,0.0,0.5);
+    rgbd_camera_pose.linear() = Eigen::Quaternionf(0.5,-0.5,0.5,-0.5).toRotationMatrix();
+
+    tf::StampedTransform logical_camera_pose;
+    tf::poseMsgToTF(logical_image_msg->pose,logical_camera_pose);
+
+    setCameraTransforms(tfTransform2eigen(robot_pose)*rgbd_camera_pose,
+                        tfTransform2eigen(logical_camera_pose));
+
+    //process models, in place: the detector reuses last frame's storage and cached boxes
+    const std::vector<lucrezio_simulation_environments::Model> &camera_models = logical_image_msg->models;
+    int num_models=camera_models.size();
+    tf::StampedTransform model_pose;
+    setNumModels(num_models);
+    for(size_t i=0; i < num_models; ++i){
+      tf::poseMsgToTF(camera_models[i].pose,model_pose);
+      setModel(i,
+               camera_models[i].type,
+               tfTransform2eigen(model_pose),
+               Eigen::Vector3f(camera_models[i].min.x,camera_models[i].min.y,camera_models[i].min.z),
+               Eigen::Vector3f(camera_models[i].max.x,camera_models[i].max.y,camera_models[i].max.z));
+    }
+
+    if(!_scene_dump_directory.empty()){
+      std::ostringstream filename;
+      filename << _scene_dump_directory << "/" << (_namespace.empty() ? "" : _namespace+"_")
+               << "scene_" << std::setw(6) << std::setfill('0') << _num_dumped++ << ".txt";
+      if(!writeData(filename.str()))
+        ROS_ERROR("Failed to write %s",filename.str().c_str());
+    }
 
-      //publish image bounding boxes
-      publishImageBoundingBoxes();
+    compute();
+    const double cost = (ros::WallTime::now()-start_time).toSec();
 
-      sensor_msgs::ImagePtr label_image_msg = cv_bridge::CvImage(std_msgs::Header(),
-                                                                 "bgr8",
-                                                                 _label_image).toImageMsg();
-      _label_image_pub.publish(label_image_msg);
+    if(verbose())
+      ROS_INFO("Frames: %lu matched, %lu dropped, %lu skewed, %lu stale, %lu superseded",
+               _synchronizer.numMatched(),_synchronizer.numDropped(),_synchronizer.numSkewed(),
+               _num_stale.load(),_num_dropped.load());
 
-      //      //            std::cerr << ".";
-      //      //            _logical_image_sub.unsubscribe();
+    //publish image bounding boxes
+    publishImageBoundingBoxes();
+
+    sensor_msgs::ImagePtr label_image_msg = cv_bridge::CvImage(std_msgs::Header(),
+                                                               "bgr8",
+                                                               labelImage()).toImageMsg();
+    _label_image_pub.publish(label_image_msg);
+
+    if(computeCloud()){
+      _cloud.header.frame_id = "camera_depth_optical_frame";
+      pcl_conversions::toPCL(_last_timestamp,_cloud.header.stamp);
+      _cloud_pub.publish(_cloud);
     }
+
+    ++_num_processed;
+    _scheduler.update(pyramid_level,cost,(ros::Time::now()-_last_timestamp).toSec());
+    publishStatus();
+
+    //      //            std::cerr << ".";
+    //      //            _logical_image_sub.unsubscribe();
   }
 
-protected:
   ros::NodeHandle _nh;
+  WorkerPool &_pool;
+  std::string _namespace;
+  std::string _robot_model;
 
   ros::Subscriber _camera_info_sub;
   bool _got_info;
 
-  message_filters::Subscriber<lucrezio_simulation_environments::LogicalImage> _logical_image_sub;
-  message_filters::Subscriber<sensor_msgs::Image> _depth_image_sub;
-  message_filters::Subscriber<sensor_msgs::Image> _rgb_image_sub;
-  typedef message_filters::sync_policies::ApproximateTime<lucrezio_simulation_environments::LogicalImage,
-  sensor_msgs::Image,
-  sensor_msgs::Image> FilterSyncPolicy;
-  message_filters::Synchronizer<FilterSyncPolicy> _synchronizer;
+  ros::Subscriber _logical_image_sub;
+  ros::Subscriber _depth_image_sub;
+  ros::Subscriber _rgb_image_sub;
+  typedef FrameSynchronizer<lucrezio_simulation_environments::LogicalImage::ConstPtr,
+  sensor_msgs::Image::ConstPtr,
+  sensor_msgs::Image::ConstPtr> Synchronizer;
+  Synchronizer _synchronizer;
 
   ros::ServiceClient _model_state_client;
 
@@ -195,8 +454,33 @@ protected:
   image_transport::ImageTransport _it;
   image_transport::Publisher _label_image_pub;
 
+  ros::Publisher _cloud_pub;
+
+  FrameScheduler _scheduler;
+  ros::Publisher _status_pub;
+
+  ros::ServiceServer _query_object_server;
+  bool _stream_pixels;
+
+  std::mutex _frame_mutex;
+  bool _busy;
+  bool _has_pending;
+  Frame _pending_frame;
+  std::atomic<unsigned long> _num_dropped;
+  std::atomic<unsigned long> _num_stale;
+  std::atomic<unsigned long> _num_processed;
+
+  std::string _scene_dump_directory;
+  unsigned long _num_dumped;
+
 private:
 
+  std::string topic(const std::string &name) const {
+    if(_namespace.empty())
+      return name;
+    return "/"+_namespace+name;
+  }
+
   Eigen::Isometry3f tfTransform2eigen(const tf::Transform& p){
     Eigen::Isometry3f iso;
     iso.translation().x()=p.getOrigin().x();
@@ -240,26 +524,112 @@ private:
     return r;
   }
 
+  void publishStatus(){
+    const FrameScheduler::Decision decision = _scheduler.decision();
+    lucrezio_semantic_perception::DetectorStatus status;
+    status.header.stamp = _last_timestamp;
+    status.pyramid_level = decision.pyramid_level;
+    status.frame_skip = decision.frame_skip;
+    status.input_rate = decision.input_rate;
+    status.output_rate = decision.output_rate;
+    status.cost = decision.cost;
+    status.latency = decision.latency;
+    status.reason = decision.reason;
+    status.num_matched = _synchronizer.numMatched();
+    status.num_dropped = _synchronizer.numDropped();
+    status.num_skewed = _synchronizer.numSkewed();
+    status.num_stale = _num_stale;
+    status.num_superseded = _num_dropped;
+    status.num_skipped = _scheduler.numSkipped();
+    status.num_processed = _num_processed;
+    status.num_model_hits = numModelHits();
+    status.num_model_misses = numModelMisses();
+    const MemoryReport report = memoryReport();
+    status.buffers.resize(report.size());
+    status.memory_usage = 0;
+    for(size_t i=0; i < report.size(); ++i){
+      status.buffers[i].name = report[i].name;
+      status.buffers[i].bytes = report[i].bytes;
+      status.memory_usage += report[i].bytes;
+    }
+    _status_pub.publish(status);
+  }
+
+  //box, statistics and, with_pixels, the pixels of the part of the detection inside
+  //the region [top_left,bottom_right] given as (row,col); false if none is in it
+  bool fillImageBoundingBox(const Detection &detection,
+                            bool with_pixels,
+                            const Eigen::Vector2i &top_left,
+                            const Eigen::Vector2i &bottom_right,
+                            lucrezio_semantic_perception::ImageBoundingBox &image_bounding_box){
+    image_bounding_box.type = detection.type();
+    image_bounding_box.id = detection.id();
+    image_bounding_box.pixels.clear();
+
+    //box and count are those of the pixels inside the region, unless the box is within it
+    Eigen::Vector2i box_top_left = detection.topLeft();
+    Eigen::Vector2i box_bottom_right = detection.bottomRight();
+    int num_pixels = detection.numPixels();
+    const bool clipped = ((box_top_left.array() < top_left.array()).any() ||
+                          (box_bottom_right.array() > bottom_right.array()).any());
+    if(clipped){
+      box_top_left = Eigen::Vector2i(10000,10000);
+      box_bottom_right = Eigen::Vector2i(-10000,-10000);
+      num_pixels = 0;
+    }
+    if(clipped || with_pixels){
+      if(with_pixels)
+        image_bounding_box.pixels.reserve(detection.numPixels());
+      lucrezio_semantic_perception::Pixel pixel;
+      std::vector<lucrezio_semantic_perception::Pixel> &pixels = image_bounding_box.pixels;
+      detection.forEachPixel([&](int r, int c){
+          if(clipped){
+            if(r < top_left.x() || c < top_left.y() || r > bottom_right.x() || c > bottom_right.y())
+              return;
+            box_top_left = box_top_left.cwiseMin(Eigen::Vector2i(r,c));
+            box_bottom_right = box_bottom_right.cwiseMax(Eigen::Vector2i(r,c));
+            ++num_pixels;
+          }
+          //pixels go as (col,row), like they always did
+          if(with_pixels){
+            pixel.r = c;
+            pixel.c = r;
+            pixels.push_back(pixel);
+          }
+        });
+    }
+
+    image_bounding_box.top_left.r = box_top_left.x();
+    image_bounding_box.top_left.c = box_top_left.y();
+    image_bounding_box.bottom_right.r = box_bottom_right.x();
+    image_bounding_box.bottom_right.c = box_bottom_right.y();
+    image_bounding_box.num_pixels = num_pixels;
+    image_bounding_box.centroid_r = detection.centroid().x();
+    image_bounding_box.centroid_c = detection.centroid().y();
+    image_bounding_box.mean_depth = detection.meanDepth();
+    image_bounding_box.median_depth = detection.medianDepth();
+    image_bounding_box.min_point.x = detection.minPoint().x();
+    image_bounding_box.min_point.y = detection.minPoint().y();
+    image_bounding_box.min_point.z = detection.minPoint().z();
+    image_bounding_box.max_point.x = detection.maxPoint().x();
+    image_bounding_box.max_point.y = detection.maxPoint().y();
+    image_bounding_box.max_point.z = detection.maxPoint().z();
+    return num_pixels > 0;
+  }
+
   void publishImageBoundingBoxes(){
     //        std::cerr << "Publishing detections" << std::endl;
     lucrezio_semantic_perception::ImageBoundingBoxesArray image_bounding_boxes;
     image_bounding_boxes.header.frame_id = "camera_depth_optical_frame";
     image_bounding_boxes.header.stamp = _last_timestamp;
-    lucrezio_semantic_perception::ImageBoundingBox image_bounding_box;
-    for(int i=0; i < _detections.size(); ++i){
+    //compute may have moved them to the snapshot
+    const DetectionVector &detections = this->detections();
+    image_bounding_boxes.image_bounding_boxes.resize(detections.size());
+    const Eigen::Vector2i top_left(0,0);
+    const Eigen::Vector2i bottom_right(_rows-1,_cols-1);
+    for(int i=0; i < detections.size(); ++i){
       //            std::cerr << "#" << i+1 << std::endl;
-      image_bounding_box.type = _detections[i].type();
-      image_bounding_box.top_left.r = _detections[i].topLeft().x();
-      image_bounding_box.top_left.c = _detections[i].topLeft().y();
-      image_bounding_box.bottom_right.r = _detections[i].bottomRight().x();
-      image_bounding_box.bottom_right.c = _detections[i].bottomRight().y();
-      lucrezio_semantic_perception::Pixel pixel;
-      for(int j=0; j < _detections[i].pixels().size(); ++j){
-        pixel.r = _detections[i].pixels()[j].x();
-        pixel.c = _detections[i].pixels()[j].y();
-        image_bounding_box.pixels.push_back(pixel);
-      }
-      image_bounding_boxes.image_bounding_boxes.push_back(image_bounding_box);
+      fillImageBoundingBox(detections[i],_stream_pixels,top_left,bottom_right,image_bounding_boxes.image_bounding_boxes[i]);
     }
     _image_bounding_boxes_pub.publish(image_bounding_boxes);
   }
@@ -268,7 +638,40 @@ private:
 int main(int argc, char** argv){
   ros::init(argc, argv, "detection_simulator");
   ros::NodeHandle nh;
-  ObjectDetectorNode simulator(nh);
+  ros::NodeHandle private_nh("~");
+
+  //declared before the pool so that the pool, and the frames still queued in it,
+  //are gone before the instances they refer to
+  std::vector<boost::shared_ptr<ObjectDetectorNode> > simulators;
+
+  int num_threads,max_queued_frames;
+  private_nh.param("num_threads",num_threads,0);
+  private_nh.param("max_queued_frames",max_queued_frames,16);
+  WorkerPool pool(num_threads,max_queued_frames);
+
+  //~detectors: list of {namespace: <ns>, robot_model: <gazebo model>}, one instance each.
+  //Without it a single instance listens to the global camera topics.
+  XmlRpc::XmlRpcValue detectors;
+  if(private_nh.getParam("detectors",detectors) && detectors.getType() == XmlRpc::XmlRpcValue::TypeArray){
+    for(int i=0; i < detectors.size(); ++i){
+      XmlRpc::XmlRpcValue &detector = detectors[i];
+      std::string ns,robot_model;
+      if(detector.getType() == XmlRpc::XmlRpcValue::TypeString){
+        ns = static_cast<std::string>(detector);
+        robot_model = ns;
+      } else if(detector.getType() == XmlRpc::XmlRpcValue::TypeStruct && detector.hasMember("namespace")){
+        ns = static_cast<std::string>(detector["namespace"]);
+        robot_model = detector.hasMember("robot_model") ? static_cast<std::string>(detector["robot_model"]) : ns;
+      } else {
+        ROS_ERROR("Skipping malformed entry %d of ~detectors",i);
+        continue;
+      }
+      simulators.push_back(boost::shared_ptr<ObjectDetectorNode>(new ObjectDetectorNode(nh,pool,ns,robot_model)));
+    }
+  } else {
+    simulators.push_back(boost::shared_ptr<ObjectDetectorNode>(new ObjectDetectorNode(nh,pool)));
+  }
+  ROS_INFO("Running %d detectors on %d threads",(int)simulators.size(),pool.numThreads());
 
   ros::spin();
 
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+
+#include <lucrezio_semantic_perception/box_table.h>
+#include <lucrezio_semantic_perception/box_test.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  //every slot past size() must hold an empty box, the vector kernels test whole blocks
+  void expectEmptyPadding(const BoxTable &table){
+    const float inf = std::numeric_limits<float>::infinity();
+    for(int j=table.size(); j<table.paddedSize(); ++j){
+      EXPECT_EQ(inf,table.xMin()[j]) << "slot " << j;
+      EXPECT_EQ(inf,table.yMin()[j]) << "slot " << j;
+      EXPECT_EQ(inf,table.zMin()[j]) << "slot " << j;
+      EXPECT_EQ(-inf,table.xMax()[j]) << "slot " << j;
+      EXPECT_EQ(-inf,table.yMax()[j]) << "slot " << j;
+      EXPECT_EQ(-inf,table.zMax()[j]) << "slot " << j;
+    }
+  }
+
+  void addBoxes(BoxTable &table, int num_boxes, float offset){
+    for(int i=0; i<num_boxes; ++i)
+      table.add(Eigen::Vector3f::Constant(offset+i),Eigen::Vector3f::Constant(offset+i+0.5f),"box");
+  }
+
+}
+
+TEST(BoxTableTest, AddKeepsPaddingEmpty){
+  BoxTable table;
+  for(int i=0; i<40; ++i){
+    addBoxes(table,1,i);
+    expectEmptyPadding(table);
+  }
+}
+
+TEST(BoxTableTest, AssignmentOverLargerTableKeepsPaddingEmpty){
+  BoxTable small,large;
+  addBoxes(small,1,0);
+  addBoxes(large,20,100);
+  large = small;
+  EXPECT_EQ(1,large.size());
+  expectEmptyPadding(large);
+
+  //the slots the old boxes held are written again, the ones after them must stay empty
+  addBoxes(large,16,200);
+  expectEmptyPadding(large);
+  for(int i=100; i<120; ++i){
+    const float p = i+0.25f;
+    EXPECT_EQ(-1,firstHitScalar(large,p,p,p));
+    EXPECT_EQ(-1,firstHitAVX2(large,p,p,p));
+    EXPECT_EQ(-1,firstHitAVX512(large,p,p,p));
+  }
+}
+
+TEST(BoxTableTest, AssignmentOfEmptyTableClearsBoxes){
+  BoxTable empty,table;
+  addBoxes(table,5,0);
+  table = empty;
+  EXPECT_TRUE(table.empty());
+  expectEmptyPadding(table);
+  EXPECT_EQ(-1,firstHitAVX2(table,0.25f,0.25f,0.25f));
+}
+
+TEST(BoxTableTest, CopyKeepsBoxesAndTypes){
+  BoxTable table;
+  table.add(Eigen::Vector3f(0,0,0),Eigen::Vector3f(1,1,1),"table");
+  table.add(Eigen::Vector3f(2,2,2),Eigen::Vector3f(3,3,3),"salt");
+  table.add(Eigen::Vector3f(4,4,4),Eigen::Vector3f(5,5,5),"table");
+  const BoxTable copy(table);
+  ASSERT_EQ(3,copy.size());
+  expectEmptyPadding(copy);
+  EXPECT_EQ(1,firstHitScalar(copy,2.5f,2.5f,2.5f));
+  EXPECT_EQ("table",copy.type(2));
+  EXPECT_EQ(copy.classId(0),copy.classId(2));
+}
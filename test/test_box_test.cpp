@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <string>
+
+#include <lucrezio_semantic_perception/box_table.h>
+#include <lucrezio_semantic_perception/box_test.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  typedef std::pair<Eigen::Vector3f,Eigen::Vector3f> Box;
+
+  //the test the kernels replace: float point, float box, the margin added in double
+  bool inRange(const Eigen::Vector3f &point, const Box &box){
+    return (point.x() >= box.first.x()-0.01 && point.x() <= box.second.x()+0.01 &&
+            point.y() >= box.first.y()-0.01 && point.y() <= box.second.y()+0.01 &&
+            point.z() >= box.first.z()-0.01 && point.z() <= box.second.z()+0.01);
+  }
+
+  int firstHitReference(const std::vector<Box> &boxes, const Eigen::Vector3f &point){
+    for(size_t j=0; j<boxes.size(); ++j)
+      if(inRange(point,boxes[j]))
+        return j;
+    return -1;
+  }
+
+  bool supports(const std::string &isa){
+    const std::string name = firstHitIsaName();
+    return name == isa || (isa == "avx2" && name == "avx512");
+  }
+
+  //floats around the bound of a box side, in double: the nearest ones on both sides and
+  //a few ulps further
+  float nearBound(std::mt19937 &engine, double bound){
+    float f = (float)bound;
+    const int ulps = (int)(engine() % 7)-3;
+    for(int i=0; i<ulps; ++i)
+      f = std::nextafter(f,std::numeric_limits<float>::infinity());
+    for(int i=0; i>ulps; --i)
+      f = std::nextafter(f,-std::numeric_limits<float>::infinity());
+    return f;
+  }
+
+  float uniform(std::mt19937 &engine, float min, float max){
+    return min+(max-min)*((engine() >> 8)*(1.0f/16777216.0f));
+  }
+
+}
+
+TEST(BoxTestTest, KernelsMatchReference){
+  std::mt19937 engine(42);
+  const bool avx2 = supports("avx2");
+  const bool avx512 = supports("avx512");
+  long num_hits = 0, num_boundary_points = 0;
+
+  for(int t=0; t<300; ++t){
+    //sizes around the 8 and 16 box blocks, boxes overlapping and sharing sides
+    const int num_boxes = engine() % 40;
+    std::vector<Box> boxes(num_boxes);
+    BoxTable table;
+    for(int j=0; j<num_boxes; ++j){
+      Eigen::Vector3f a,b;
+      for(int k=0; k<3; ++k){
+        a[k] = uniform(engine,-5,5);
+        b[k] = a[k]+uniform(engine,0,2);
+      }
+      if(j && engine() % 4 == 0)
+        a = boxes[engine() % j].second;
+      boxes[j] = Box(a,b);
+      table.add(a,b,0.01,"box");
+    }
+    ASSERT_EQ(num_boxes,table.size());
+
+    for(int i=0; i<2000; ++i){
+      Eigen::Vector3f point;
+      if(num_boxes && i % 2){
+        //on or next to the sides of a box
+        const Box &box = boxes[engine() % num_boxes];
+        for(int k=0; k<3; ++k){
+          switch(engine() % 3){
+          case 0: point[k] = nearBound(engine,box.first[k]-0.01); break;
+          case 1: point[k] = nearBound(engine,box.second[k]+0.01); break;
+          default: point[k] = uniform(engine,box.first[k],box.second[k]);
+          }
+        }
+        ++num_boundary_points;
+      } else {
+        for(int k=0; k<3; ++k)
+          point[k] = uniform(engine,-6,8);
+      }
+
+      const int expected = firstHitReference(boxes,point);
+      num_hits += (expected >= 0);
+      ASSERT_EQ(expected,firstHitScalar(table,point.x(),point.y(),point.z()))
+          << "point " << point.transpose() << ", table " << t;
+      if(avx2){
+        ASSERT_EQ(expected,firstHitAVX2(table,point.x(),point.y(),point.z()))
+            << "point " << point.transpose() << ", table " << t;
+      }
+      if(avx512){
+        ASSERT_EQ(expected,firstHitAVX512(table,point.x(),point.y(),point.z()))
+            << "point " << point.transpose() << ", table " << t;
+      }
+    }
+  }
+  //the points must exercise both outcomes
+  EXPECT_GT(num_hits,num_boundary_points/4);
+  EXPECT_LT(num_hits,num_boundary_points);
+}
+
+TEST(BoxTestTest, SelectedTableMatchesSource){
+  std::mt19937 engine(7);
+  BoxTable table,selected;
+  for(int j=0; j<37; ++j){
+    const Eigen::Vector3f a(uniform(engine,-1,1),uniform(engine,-1,1),uniform(engine,-1,1));
+    table.add(a,a+Eigen::Vector3f::Constant(0.5f),0.01,j % 2 ? "salt" : "table");
+  }
+  std::vector<int> indices;
+  for(int j=0; j<37; j+=3)
+    indices.push_back(j);
+  selected.select(table,indices);
+  ASSERT_EQ((int)indices.size(),selected.size());
+
+  for(int i=0; i<5000; ++i){
+    const float x = uniform(engine,-1.2f,1.7f), y = uniform(engine,-1.2f,1.7f), z = uniform(engine,-1.2f,1.7f);
+    int expected = -1;
+    for(size_t k=0; k<indices.size() && expected < 0; ++k){
+      const int j = indices[k];
+      if(x >= table.xMin()[j] && x <= table.xMax()[j] && y >= table.yMin()[j] && y <= table.yMax()[j] &&
+         z >= table.zMin()[j] && z <= table.zMax()[j])
+        expected = k;
+    }
+    EXPECT_EQ(expected,firstHitScalar(selected,x,y,z));
+    if(supports("avx2")){
+      EXPECT_EQ(expected,firstHitAVX2(selected,x,y,z));
+    }
+    if(supports("avx512")){
+      EXPECT_EQ(expected,firstHitAVX512(selected,x,y,z));
+    }
+  }
+  for(size_t k=0; k<indices.size(); ++k)
+    EXPECT_EQ(table.classId(indices[k]),selected.classId(k));
+}
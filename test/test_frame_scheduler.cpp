@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <lucrezio_semantic_perception/frame_scheduler.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  //frames arriving every period seconds, each measured at the level it was given
+  class SyntheticCamera{
+  public:
+    SyntheticCamera(FrameScheduler &scheduler_, double period_):
+      _scheduler(scheduler_),
+      _period(period_),
+      _now(0){}
+
+    //each level costs a quarter of the previous one, like the scheduler assumes;
+    //returns how many of the frames were accepted
+    int run(int num_frames, double level_0_cost){
+      int num_accepted = 0;
+      for(int i=0; i<num_frames; ++i){
+        int pyramid_level = -1;
+        _now += _period;
+        if(!_scheduler.accept(_now,pyramid_level))
+          continue;
+        ++num_accepted;
+        const double cost = level_0_cost/(1 << 2*pyramid_level);
+        _scheduler.update(pyramid_level,cost,cost);
+      }
+      return num_accepted;
+    }
+
+  private:
+    FrameScheduler &_scheduler;
+    double _period;
+    double _now;
+  };
+
+  const double kPeriod = 1.0/30;
+
+}
+
+TEST(FrameSchedulerTest, ProcessesEveryFrameWhenUnconstrained){
+  FrameScheduler scheduler;
+  SyntheticCamera camera(scheduler,kPeriod);
+  EXPECT_EQ(20,camera.run(20,1.0));
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(0,decision.pyramid_level);
+  EXPECT_EQ(1,decision.frame_skip);
+  EXPECT_EQ("unconstrained",decision.reason);
+  EXPECT_NEAR(30,decision.input_rate,1e-6);
+  EXPECT_NEAR(1.0,decision.cost,1e-9);
+  EXPECT_EQ(20ul,scheduler.numAccepted());
+  EXPECT_EQ(0ul,scheduler.numSkipped());
+}
+
+TEST(FrameSchedulerTest, MeasuresBeforeDeciding){
+  FrameScheduler scheduler;
+  scheduler.setTargetRate(30);
+  int pyramid_level = -1;
+  EXPECT_TRUE(scheduler.accept(0,pyramid_level));
+  EXPECT_EQ(0,pyramid_level);
+  EXPECT_TRUE(scheduler.accept(kPeriod,pyramid_level));
+  EXPECT_EQ("measuring",scheduler.decision().reason);
+  EXPECT_EQ(1,scheduler.decision().frame_skip);
+}
+
+TEST(FrameSchedulerTest, KeepsFullRateWhenTheDetectorKeepsUp){
+  FrameScheduler scheduler;
+  scheduler.setTargetRate(30);
+  SyntheticCamera camera(scheduler,kPeriod);
+  EXPECT_EQ(20,camera.run(20,0.01));
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(0,decision.pyramid_level);
+  EXPECT_EQ(1,decision.frame_skip);
+  EXPECT_EQ("full rate",decision.reason);
+  EXPECT_NEAR(30,decision.output_rate,1e-6);
+}
+
+//15 fps still reaches the target, so frames are skipped rather than lowering the resolution
+TEST(FrameSchedulerTest, SkipsFramesToReachTheTarget){
+  FrameScheduler scheduler;
+  scheduler.setTargetRate(10);
+  SyntheticCamera camera(scheduler,kPeriod);
+  camera.run(10,0.05);
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(0,decision.pyramid_level);
+  EXPECT_EQ(2,decision.frame_skip);
+  EXPECT_EQ("skipping frames",decision.reason);
+  EXPECT_NEAR(15,decision.output_rate,1e-6);
+  EXPECT_NEAR(0.05,decision.cost,1e-9);
+
+  //one frame out of two from now on
+  EXPECT_EQ(10,camera.run(20,0.05));
+}
+
+//level 0 would need one frame out of three, 10 fps; level 1 runs every frame
+TEST(FrameSchedulerTest, ReducesResolutionToReachTheTarget){
+  FrameScheduler scheduler;
+  scheduler.setTargetRate(30);
+  SyntheticCamera camera(scheduler,kPeriod);
+  camera.run(10,0.09);
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(1,decision.pyramid_level);
+  EXPECT_EQ(1,decision.frame_skip);
+  EXPECT_EQ("reduced resolution",decision.reason);
+  EXPECT_NEAR(0.0225,decision.cost,1e-9);
+  EXPECT_EQ(20,camera.run(20,0.09));
+}
+
+TEST(FrameSchedulerTest, ReducesResolutionBeyondMaxFrameSkip){
+  FrameScheduler scheduler;
+  scheduler.setTargetRate(5);
+  scheduler.setMaxFrameSkip(1);
+  SyntheticCamera camera(scheduler,kPeriod);
+  camera.run(10,0.05);
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(1,decision.pyramid_level);
+  EXPECT_EQ(1,decision.frame_skip);
+}
+
+TEST(FrameSchedulerTest, ReducesResolutionToMeetTheLatencyBudget){
+  FrameScheduler scheduler;
+  scheduler.setLatencyBudget(0.05);
+  SyntheticCamera camera(scheduler,kPeriod);
+  camera.run(10,0.1);
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(1,decision.pyramid_level);
+  EXPECT_EQ(1,decision.frame_skip);
+  EXPECT_EQ("reduced resolution",decision.reason);
+}
+
+//nothing fits: the coarsest level, skipping as many frames as allowed
+TEST(FrameSchedulerTest, FallsBackToTheCoarsestLevelWhenOverBudget){
+  FrameScheduler scheduler;
+  scheduler.setLatencyBudget(0.05);
+  scheduler.setMaxPyramidLevel(2);
+  scheduler.setMaxFrameSkip(4);
+  int pyramid_level = -1;
+  scheduler.accept(0,pyramid_level);
+  scheduler.accept(kPeriod,pyramid_level);
+  scheduler.update(0,10,10);
+  scheduler.accept(2*kPeriod,pyramid_level);
+
+  const FrameScheduler::Decision decision = scheduler.decision();
+  EXPECT_EQ(2,pyramid_level);
+  EXPECT_EQ(2,decision.pyramid_level);
+  EXPECT_EQ(4,decision.frame_skip);
+  EXPECT_EQ("over budget",decision.reason);
+  EXPECT_NEAR(10.0/16,decision.cost,1e-9);
+}
+
+//a finer level than the current one must fit with headroom, so that the scheduler doesn't
+//go back and forth when the cost sits right at the budget
+TEST(FrameSchedulerTest, ReturnsToFinerLevelsWithHeadroom){
+  FrameScheduler scheduler;
+  scheduler.setLatencyBudget(0.05);
+
+  //only level 1 is ever measured, level 0 is extrapolated as 4 times its cost
+  int pyramid_level = -1;
+  scheduler.accept(0,pyramid_level);
+  scheduler.accept(kPeriod,pyramid_level);
+  scheduler.update(1,0.015,0.015);
+  scheduler.accept(2*kPeriod,pyramid_level);
+  ASSERT_EQ(1,pyramid_level);
+
+  //0.045 fits the budget, but not with headroom
+  for(int i=0; i<100; ++i)
+    scheduler.update(1,0.01125,0.01125);
+  EXPECT_EQ(1,scheduler.decision().pyramid_level);
+
+  //0.036 does
+  for(int i=0; i<100; ++i)
+    scheduler.update(1,0.009,0.009);
+  EXPECT_EQ(0,scheduler.decision().pyramid_level);
+}
+
+//the estimates are moving averages: a single slow frame doesn't change the decision
+TEST(FrameSchedulerTest, SmoothsCostSpikes){
+  FrameScheduler scheduler;
+  scheduler.setTargetRate(30);
+  SyntheticCamera camera(scheduler,kPeriod);
+  camera.run(10,0.01);
+  scheduler.update(0,0.1,0.1);
+  EXPECT_EQ(0,scheduler.decision().pyramid_level);
+  EXPECT_EQ(1,scheduler.decision().frame_skip);
+  EXPECT_NEAR(0.8*0.01+0.2*0.1,scheduler.decision().cost,1e-9);
+}
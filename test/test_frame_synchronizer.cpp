@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <lucrezio_semantic_perception/frame_synchronizer.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  struct Triple{
+    Triple(int first_, int reference_, int third_):first(first_),reference(reference_),third(third_){}
+    bool operator==(const Triple &other) const {
+      return first == other.first && reference == other.reference && third == other.third;
+    }
+    int first;
+    int reference;
+    int third;
+  };
+
+  std::ostream &operator<<(std::ostream &stream, const Triple &triple){
+    return stream << "(" << triple.first << "," << triple.reference << "," << triple.third << ")";
+  }
+
+  //messages are ints, which the tests set to their stamp in milliseconds
+  class FrameSynchronizerTest : public ::testing::Test{
+  protected:
+    FrameSynchronizerTest():_synchronizer(0.05,0.5,5){
+      _synchronizer.setCallback([this](const int &first, const int &reference, const int &third){
+          _matches.push_back(Triple(first,reference,third));
+        });
+    }
+
+    //messages arrive when they are stamped unless now is given
+    void addFirst(int stamp, int now = -1){_synchronizer.addFirst(stamp,stamp/1000.0,(now < 0 ? stamp : now)/1000.0);}
+    void addReference(int stamp, int now = -1){_synchronizer.addReference(stamp,stamp/1000.0,(now < 0 ? stamp : now)/1000.0);}
+    void addThird(int stamp, int now = -1){_synchronizer.addThird(stamp,stamp/1000.0,(now < 0 ? stamp : now)/1000.0);}
+
+    FrameSynchronizer<int,int,int> _synchronizer;
+    std::vector<Triple> _matches;
+  };
+
+}
+
+TEST_F(FrameSynchronizerTest, MatchesWithinSkew){
+  addFirst(1010);
+  addThird(990);
+  EXPECT_TRUE(_matches.empty());
+  addReference(1000);
+  ASSERT_EQ(1u,_matches.size());
+  EXPECT_EQ(Triple(1010,1000,990),_matches[0]);
+  EXPECT_EQ(1ul,_synchronizer.numMatched());
+  EXPECT_EQ(0ul,_synchronizer.numDropped());
+  EXPECT_EQ(0ul,_synchronizer.numSkewed());
+}
+
+//the reference waits for the streams that have nothing within the skew yet
+TEST_F(FrameSynchronizerTest, WaitsForMissingMessages){
+  addReference(1000);
+  addFirst(1000);
+  EXPECT_TRUE(_matches.empty());
+  addThird(1040);
+  ASSERT_EQ(1u,_matches.size());
+  EXPECT_EQ(Triple(1000,1000,1040),_matches[0]);
+}
+
+//older messages than the matched ones are dropped with it
+TEST_F(FrameSynchronizerTest, PicksTheClosestMessage){
+  addFirst(960);
+  addFirst(1030);
+  addFirst(1100);
+  addThird(1000);
+  addReference(1040);
+  ASSERT_EQ(1u,_matches.size());
+  EXPECT_EQ(Triple(1030,1040,1000),_matches[0]);
+  EXPECT_EQ(1ul,_synchronizer.numDropped());
+
+  //1100 is still there for the next reference
+  addThird(1110);
+  addReference(1105);
+  ASSERT_EQ(2u,_matches.size());
+  EXPECT_EQ(Triple(1100,1105,1110),_matches[1]);
+}
+
+//a stream already past the reference's skew can't match it anymore
+TEST_F(FrameSynchronizerTest, DropsReferencesOutOfSkew){
+  addThird(1000);
+  addReference(1000);
+  addFirst(1080);
+  EXPECT_TRUE(_matches.empty());
+  EXPECT_EQ(1ul,_synchronizer.numSkewed());
+
+  //the third message is kept for a later reference
+  addReference(1040);
+  ASSERT_EQ(1u,_matches.size());
+  EXPECT_EQ(Triple(1080,1040,1000),_matches[0]);
+  EXPECT_EQ(1ul,_synchronizer.numSkewed());
+}
+
+TEST_F(FrameSynchronizerTest, DropsStaleMessages){
+  //arrives 0.6 s late
+  addReference(1000,1600);
+  addFirst(1000,1600);
+  addThird(1000,1600);
+  EXPECT_TRUE(_matches.empty());
+  EXPECT_EQ(3ul,_synchronizer.numDropped());
+
+  //queued in time, but too old by the time its partners arrive
+  addReference(2000);
+  addFirst(2000,2600);
+  addThird(2600);
+  EXPECT_TRUE(_matches.empty());
+  EXPECT_EQ(5ul,_synchronizer.numDropped());
+  EXPECT_EQ(0ul,_synchronizer.numMatched());
+}
+
+TEST_F(FrameSynchronizerTest, EvictsTheOldestBeyondQueueSize){
+  _synchronizer.setQueueSize(2);
+  addReference(1000);
+  addReference(1100);
+  addReference(1200);
+  EXPECT_EQ(1ul,_synchronizer.numDropped());
+
+  //the first reference was evicted, its partners can't match anyone
+  addFirst(1000);
+  addThird(1000);
+  EXPECT_TRUE(_matches.empty());
+
+  addFirst(1100);
+  addThird(1100);
+  ASSERT_EQ(1u,_matches.size());
+  EXPECT_EQ(Triple(1100,1100,1100),_matches[0]);
+  EXPECT_EQ(3ul,_synchronizer.numDropped());
+  EXPECT_EQ(0ul,_synchronizer.numSkewed());
+}
+
+//messages arriving out of order are sorted by stamp
+TEST_F(FrameSynchronizerTest, SortsLateMessages){
+  addFirst(1100);
+  addFirst(1000,1100);
+  addThird(1000);
+  addReference(1000);
+  ASSERT_EQ(1u,_matches.size());
+  EXPECT_EQ(Triple(1000,1000,1000),_matches[0]);
+}
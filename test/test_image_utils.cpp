@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+
+#include <lucrezio_semantic_perception/image_utils.h>
+
+namespace{
+
+  //10x14 pixels, so that 4x4 tiles leave a partial row and column of tiles; the point
+  //of pixel (r,c) is (c,r,depth), every fifth pixel is invalid and so is the whole
+  //top left tile
+  Float3Image pointsImage(){
+    Float3Image points_image(10,14);
+    for(int r=0; r<points_image.rows; ++r)
+      for(int c=0; c<points_image.cols; ++c){
+        if((r < 4 && c < 4) || (r*points_image.cols+c)%5 == 0)
+          points_image(r,c) = cv::Vec3f(0,0,0);
+        else
+          points_image(r,c) = cv::Vec3f(c,r,1+0.1f*r+0.01f*c);
+      }
+    return points_image;
+  }
+
+  //brute force summary of the points inside [r_min,r_max]x[c_min,c_max]
+  ImageTile groundTruthTile(const Float3Image &points_image, int r_min, int c_min, int r_max, int c_max){
+    ImageTile tile;
+    tile.r_min = r_min;
+    tile.c_min = c_min;
+    tile.r_max = r_max;
+    tile.c_max = c_max;
+    tile.num_valid = 0;
+    tile.min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    tile.max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    for(int r=r_min; r<=r_max; ++r)
+      for(int c=c_min; c<=c_max; ++c){
+        const cv::Vec3f &p = points_image(r,c);
+        if(cv::norm(p) < 1e-3)
+          continue;
+        ++tile.num_valid;
+        const Eigen::Vector3f point(p[0],p[1],p[2]);
+        tile.min = tile.min.cwiseMin(point);
+        tile.max = tile.max.cwiseMax(point);
+      }
+    return tile;
+  }
+
+  void expectTilesEqual(const ImageTile &expected, const ImageTile &tile){
+    EXPECT_EQ(expected.r_min,tile.r_min);
+    EXPECT_EQ(expected.c_min,tile.c_min);
+    EXPECT_EQ(expected.r_max,tile.r_max);
+    EXPECT_EQ(expected.c_max,tile.c_max);
+    EXPECT_EQ(expected.num_valid,tile.num_valid);
+    if(!expected.num_valid)
+      return;
+    for(int i=0; i<3; ++i){
+      EXPECT_FLOAT_EQ(expected.min[i],tile.min[i]);
+      EXPECT_FLOAT_EQ(expected.max[i],tile.max[i]);
+    }
+  }
+
+}
+
+TEST(ImageTilesTest, CoverTheImageRowMajor){
+  const Float3Image points_image = pointsImage();
+  ImageTileVector tiles;
+  computeImageTiles(tiles,Float3Points(points_image),4);
+  ASSERT_EQ(12u,tiles.size());
+
+  for(int tr=0; tr<3; ++tr)
+    for(int tc=0; tc<4; ++tc){
+      SCOPED_TRACE(testing::Message() << "tile " << tr << "," << tc);
+      const ImageTile &tile = tiles[tr*4+tc];
+      EXPECT_EQ(4*tr,tile.r_min);
+      EXPECT_EQ(4*tc,tile.c_min);
+      //the last row and column of tiles are clipped to the image
+      EXPECT_EQ(tr < 2 ? 4*tr+3 : 9,tile.r_max);
+      EXPECT_EQ(tc < 3 ? 4*tc+3 : 13,tile.c_max);
+    }
+}
+
+TEST(ImageTilesTest, SummarizeTheValidPoints){
+  const Float3Image points_image = pointsImage();
+  ImageTileVector tiles;
+  computeImageTiles(tiles,Float3Points(points_image),4);
+  ASSERT_EQ(12u,tiles.size());
+
+  int num_valid = 0;
+  for(size_t i=0; i<tiles.size(); ++i){
+    SCOPED_TRACE(testing::Message() << "tile " << i);
+    const ImageTile &tile = tiles[i];
+    expectTilesEqual(groundTruthTile(points_image,tile.r_min,tile.c_min,tile.r_max,tile.c_max),tile);
+    num_valid += tile.num_valid;
+  }
+  EXPECT_EQ(100,num_valid);
+
+  //no valid point: the bounds stay empty, so that no depth interval overlaps them
+  EXPECT_EQ(0,tiles[0].num_valid);
+  EXPECT_GT(tiles[0].min.z(),tiles[0].max.z());
+
+  //rows 8-9, columns 12-13, (8,13) is invalid
+  const ImageTile &corner = tiles.back();
+  EXPECT_EQ(3,corner.num_valid);
+  EXPECT_FLOAT_EQ(1+0.8f+0.12f,corner.min.z());
+  EXPECT_FLOAT_EQ(1+0.9f+0.13f,corner.max.z());
+}
+
+TEST(ImageTilesTest, OneTileForTheWholeImage){
+  const Float3Image points_image = pointsImage();
+  ImageTileVector tiles;
+  computeImageTiles(tiles,points_image,32);
+  ASSERT_EQ(1u,tiles.size());
+  expectTilesEqual(groundTruthTile(points_image,0,0,9,13),tiles[0]);
+}
+
+//points rebuilt from raw depth give the same tiles as the stored ones
+TEST(ImageTilesTest, CompactPointsMatchFloat3Points){
+  const int rows = 10;
+  const int cols = 14;
+  DepthLUT lut;
+  initializeDepthLUT(lut,0.001f,0.5f,5.0f);
+
+  RawDepthImage depth_image(rows,cols);
+  Float2Image rays(rows,cols);
+  Float3Image points_image(rows,cols);
+  for(int r=0; r<rows; ++r)
+    for(int c=0; c<cols; ++c){
+      //0 and the out of range 6000 are invalid
+      const unsigned short raw = (r*cols+c)%7 == 0 ? 0 : ((r*cols+c)%11 == 0 ? 6000 : 1000+37*r+11*c);
+      depth_image(r,c) = raw;
+      rays(r,c) = cv::Vec2f(0.01f*(c-7),0.01f*(r-5));
+      const float d = lut[raw];
+      points_image(r,c) = cv::Vec3f(rays(r,c)[0]*d,rays(r,c)[1]*d,d);
+    }
+
+  ImageTileVector compact_tiles;
+  computeImageTiles(compact_tiles,CompactPoints(depth_image,rays,lut),4);
+  ImageTileVector tiles;
+  computeImageTiles(tiles,Float3Points(points_image),4);
+  ASSERT_EQ(tiles.size(),compact_tiles.size());
+  for(size_t i=0; i<tiles.size(); ++i){
+    SCOPED_TRACE(testing::Message() << "tile " << i);
+    EXPECT_GT(tiles[i].num_valid,0);
+    expectTilesEqual(tiles[i],compact_tiles[i]);
+  }
+}
+
+TEST(ImageTilesTest, RejectsNonPositiveTileSize){
+  const Float3Image points_image = pointsImage();
+  ImageTileVector tiles;
+  EXPECT_THROW(computeImageTiles(tiles,Float3Points(points_image),0),std::runtime_error);
+}
+
+//the compile-time grid gives the tiles of the dynamic one
+TEST(ImageTilesTest, FixedGridMatchesDynamicTiles){
+  typedef FixedTileGrid<8,12,4> Grid;
+  const Float3Image points_image = pointsImage();
+  Float3Image cropped(Grid::rows,Grid::cols);
+  for(int r=0; r<cropped.rows; ++r)
+    for(int c=0; c<cropped.cols; ++c)
+      cropped(r,c) = points_image(r,c);
+  ImageTileVector fixed_tiles;
+  computeFixedImageTiles<Grid>(fixed_tiles,Float3Points(cropped));
+  ImageTileVector tiles;
+  computeImageTiles(tiles,Float3Points(cropped),Grid::tile_size);
+  ASSERT_EQ(6u,fixed_tiles.size());
+  ASSERT_EQ(tiles.size(),fixed_tiles.size());
+  for(size_t i=0; i<tiles.size(); ++i){
+    SCOPED_TRACE(testing::Message() << "tile " << i);
+    expectTilesEqual(tiles[i],fixed_tiles[i]);
+  }
+
+  EXPECT_THROW(computeFixedImageTiles<Grid>(fixed_tiles,Float3Points(points_image)),std::runtime_error);
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <lucrezio_semantic_perception/label_codec.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  //a static checkerboard below two coloured rectangles shifted right by offset pixels
+  RGBImage labelImage(int rows, int cols, int offset){
+    RGBImage image(rows,cols);
+    for(int r=0; r<rows; ++r)
+      for(int c=0; c<cols; ++c){
+        cv::Vec3b color(0,0,0);
+        if(r >= 10 && r < 40 && c >= 20+offset && c < 50+offset)
+          color = cv::Vec3b(255,0,0);
+        else if(r >= 30 && r < 70 && c >= 5+offset && c < 25+offset)
+          color = cv::Vec3b(0,128,64);
+        else if(r >= 50 && ((r/4+c/4) & 1))
+          color = cv::Vec3b(0,0,255);
+        image(r,c) = color;
+      }
+    return image;
+  }
+
+  //every pixel a different colour, so that the encoder falls back to raw
+  RGBImage noiseImage(int rows, int cols){
+    RGBImage image(rows,cols);
+    for(int r=0; r<rows; ++r)
+      for(int c=0; c<cols; ++c)
+        image(r,c) = cv::Vec3b(r,c,r^c);
+    return image;
+  }
+
+  bool equal(const RGBImage &a, const RGBImage &b){
+    if(a.rows != b.rows || a.cols != b.cols)
+      return false;
+    for(int r=0; r<a.rows; ++r)
+      for(int c=0; c<a.cols; ++c)
+        if(a(r,c) != b(r,c))
+          return false;
+    return true;
+  }
+
+  void writeVarint(std::vector<unsigned char> &out, unsigned long value){
+    while(value >= 0x80){
+      out.push_back((value & 0x7f) | 0x80);
+      value >>= 7;
+    }
+    out.push_back(value);
+  }
+
+  //version, mode, sequence, rows and cols
+  std::vector<unsigned char> header(LabelImageEncoder::Mode mode, unsigned int sequence, unsigned int rows, unsigned int cols){
+    std::vector<unsigned char> packet;
+    packet.push_back(1);
+    packet.push_back(mode);
+    writeVarint(packet,sequence);
+    writeVarint(packet,rows);
+    writeVarint(packet,cols);
+    return packet;
+  }
+
+  bool decode(LabelImageDecoder &decoder, const std::vector<unsigned char> &packet){
+    return decoder.decode(&packet[0],packet.size());
+  }
+
+}
+
+TEST(LabelCodec, RoundTrip){
+  LabelImageEncoder encoder;
+  encoder.setKeyframeInterval(4);
+  LabelImageDecoder decoder;
+  std::vector<unsigned char> packet;
+  for(int f=0; f<6; ++f){
+    const RGBImage image = labelImage(80,120,f);
+    encoder.encode(image,packet);
+    EXPECT_EQ(f%4 ? LabelImageEncoder::DeltaMode : LabelImageEncoder::KeyframeMode,encoder.lastMode());
+    ASSERT_TRUE(decode(decoder,packet)) << "frame " << f;
+    EXPECT_TRUE(equal(image,decoder.image())) << "frame " << f;
+  }
+
+  const RGBImage image = noiseImage(64,64);
+  encoder.encode(image,packet);
+  EXPECT_EQ(LabelImageEncoder::RawMode,encoder.lastMode());
+  ASSERT_TRUE(decode(decoder,packet));
+  EXPECT_TRUE(equal(image,decoder.image()));
+}
+
+//a few bytes describing a huge image must not allocate it
+TEST(LabelCodec, RejectsHugeImagesBeforeAllocating){
+  LabelImageDecoder decoder;
+  const unsigned int side = 65535;
+
+  //one run of black over every pixel
+  std::vector<unsigned char> keyframe = header(LabelImageEncoder::KeyframeMode,0,side,side);
+  writeVarint(keyframe,1);
+  keyframe.insert(keyframe.end(),3,0);
+  writeVarint(keyframe,(unsigned long)side*side-1);
+  keyframe.push_back(0);
+  EXPECT_FALSE(decode(decoder,keyframe));
+  EXPECT_TRUE(decoder.image().empty());
+
+  std::vector<unsigned char> raw = header(LabelImageEncoder::RawMode,0,side,side);
+  raw.insert(raw.end(),3,0);
+  EXPECT_FALSE(decode(decoder,raw));
+  EXPECT_TRUE(decoder.image().empty());
+
+  //within the cap the same packet is fine
+  decoder.setMaxPixels((size_t)side*side);
+  std::vector<unsigned char> small = header(LabelImageEncoder::KeyframeMode,0,2,3);
+  writeVarint(small,1);
+  small.insert(small.end(),3,7);
+  writeVarint(small,5);
+  small.push_back(0);
+  EXPECT_TRUE(decode(decoder,small));
+  EXPECT_EQ(cv::Vec3b(7,7,7),decoder.image()(1,2));
+}
+
+//malformed packets fail, leave the last image alone and need a keyframe to resume
+TEST(LabelCodec, RejectsMalformedPackets){
+  LabelImageEncoder encoder;
+  LabelImageDecoder decoder;
+  std::vector<unsigned char> packet;
+  const RGBImage first = labelImage(80,120,0);
+  encoder.encode(first,packet);
+  ASSERT_TRUE(decode(decoder,packet));
+
+  encoder.encode(labelImage(80,120,3),packet);
+  ASSERT_EQ(LabelImageEncoder::DeltaMode,encoder.lastMode());
+  std::vector<unsigned char> truncated(packet.begin(),packet.end()-2);
+  EXPECT_FALSE(decode(decoder,truncated));
+  EXPECT_TRUE(equal(first,decoder.image()));
+  EXPECT_FALSE(decode(decoder,packet));
+
+  //runs covering too few pixels, a colour outside the palette, a raw image one byte short
+  std::vector<unsigned char> short_runs = header(LabelImageEncoder::KeyframeMode,0,2,3);
+  writeVarint(short_runs,1);
+  short_runs.insert(short_runs.end(),3,7);
+  writeVarint(short_runs,4);
+  short_runs.push_back(0);
+  EXPECT_FALSE(decode(decoder,short_runs));
+
+  std::vector<unsigned char> bad_index = header(LabelImageEncoder::KeyframeMode,0,2,3);
+  writeVarint(bad_index,1);
+  bad_index.insert(bad_index.end(),3,7);
+  writeVarint(bad_index,5);
+  bad_index.push_back(1);
+  EXPECT_FALSE(decode(decoder,bad_index));
+
+  std::vector<unsigned char> short_raw = header(LabelImageEncoder::RawMode,0,2,3);
+  short_raw.insert(short_raw.end(),17,0);
+  EXPECT_FALSE(decode(decoder,short_raw));
+  EXPECT_TRUE(equal(first,decoder.image()));
+
+  encoder.reset();
+  const RGBImage keyframe = labelImage(80,120,5);
+  encoder.encode(keyframe,packet);
+  ASSERT_TRUE(decode(decoder,packet));
+  EXPECT_TRUE(equal(keyframe,decoder.image()));
+}
@@ -0,0 +1,792 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <lucrezio_semantic_perception/object_detector.h>
+#include <lucrezio_semantic_perception/synthetic_scene.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  struct Configuration{
+    ObjectDetector::Engine engine;
+    int pyramid_level;
+    bool refine_boundaries;
+    ObjectDetector::PointFormat point_format;
+  };
+
+  std::ostream &operator<<(std::ostream &stream, const Configuration &configuration){
+    return stream << (configuration.engine == ObjectDetector::RasterizationEngine ? "rasterization" : "back-projection")
+                  << ", level " << configuration.pyramid_level
+                  << (configuration.refine_boundaries ? ", refined" : "")
+                  << (configuration.point_format == ObjectDetector::CompactPointFormat ? ", compact" : ", float3");
+  }
+
+  //detections are indexed like the models
+  IntImage labelImage(const ObjectDetector &detector, int rows, int cols){
+    IntImage labels(rows,cols);
+    labels = -1;
+    const DetectionVector &detections = detector.detections();
+    for(int j=0; j<(int)detections.size(); ++j)
+      detections[j].forEachPixel([&labels,j](int r, int c){labels(r,c) = j;});
+    return labels;
+  }
+
+  //the labels a pyramid level must give: the box test runs on every stride-th pixel,
+  //whose label then covers its block; with refine_boundaries, blocks whose 4-neighbours
+  //have a different label keep the labels of each of their pixels
+  IntImage expectedLabels(const IntImage &labels, int stride, bool refine_boundaries){
+    if(stride == 1)
+      return labels.clone();
+    const int coarse_rows = (labels.rows+stride-1)/stride;
+    const int coarse_cols = (labels.cols+stride-1)/stride;
+    IntImage coarse(coarse_rows,coarse_cols);
+    for(int r=0; r<coarse_rows; ++r)
+      for(int c=0; c<coarse_cols; ++c)
+        coarse(r,c) = labels(r*stride,c*stride);
+
+    IntImage expected(labels.rows,labels.cols);
+    for(int r=0; r<coarse_rows; ++r)
+      for(int c=0; c<coarse_cols; ++c){
+        const int label = coarse(r,c);
+        const bool boundary = (refine_boundaries &&
+                               ((r > 0 && coarse(r-1,c) != label) ||
+                                (r < coarse_rows-1 && coarse(r+1,c) != label) ||
+                                (c > 0 && coarse(r,c-1) != label) ||
+                                (c < coarse_cols-1 && coarse(r,c+1) != label)));
+        for(int rr=r*stride; rr<std::min((r+1)*stride,labels.rows); ++rr)
+          for(int cc=c*stride; cc<std::min((c+1)*stride,labels.cols); ++cc)
+            expected(rr,cc) = boundary ? labels(rr,cc) : label;
+      }
+    return expected;
+  }
+
+  long countMismatches(const IntImage &a, const IntImage &b){
+    long num_mismatches = 0;
+    for(int r=0; r<a.rows; ++r)
+      for(int c=0; c<a.cols; ++c)
+        num_mismatches += (a(r,c) != b(r,c));
+    return num_mismatches;
+  }
+
+  bool equal(const RGBImage &a, const RGBImage &b){
+    if(a.rows != b.rows || a.cols != b.cols)
+      return false;
+    for(int r=0; r<a.rows; ++r)
+      for(int c=0; c<a.cols; ++c)
+        if(a(r,c) != b(r,c))
+          return false;
+    return true;
+  }
+
+  //computes a frame and returns its labels
+  IntImage computeLabels(ObjectDetector &detector,
+                         const SyntheticScene &scene,
+                         const cv::Mat &depth_image,
+                         const Eigen::Isometry3f &rgbd_camera_transform,
+                         const ModelVector &models){
+    detector.setImages(scene.rgbImage(),depth_image);
+    detector.setCameraTransforms(rgbd_camera_transform,scene.logicalCameraTransform());
+    detector.setModels(models);
+    detector.compute();
+    return labelImage(detector,depth_image.rows,depth_image.cols);
+  }
+
+  class ObjectDetectorTest : public ::testing::TestWithParam<Configuration>{
+  protected:
+    void configure(ObjectDetector &detector, const SyntheticScene &scene) const {
+      const Configuration &configuration = GetParam();
+      detector.setVerbose(false);
+      detector.setEngine(configuration.engine);
+      detector.setPyramidLevel(configuration.pyramid_level);
+      detector.setRefineBoundaries(configuration.refine_boundaries);
+      detector.setPointFormat(configuration.point_format);
+      detector.setK(scene.K());
+    }
+  };
+
+}
+
+TEST_P(ObjectDetectorTest, MatchesExpectedLabels){
+  const Configuration &configuration = GetParam();
+  SyntheticScene scene;
+  for(unsigned int seed=0; seed<3; ++seed){
+    scene.generate(seed);
+    ObjectDetector detector;
+    configure(detector,scene);
+    detector.setImages(scene.rgbImage(),scene.depthImage());
+    detector.setCameraTransforms(scene.rgbdCameraTransform(),scene.logicalCameraTransform());
+    detector.setModels(scene.models());
+    detector.compute();
+
+    const IntImage &labels = scene.expectedLabels();
+    const IntImage expected = expectedLabels(labels,1 << configuration.pyramid_level,configuration.refine_boundaries);
+    ASSERT_EQ((int)detector.detections().size(),(int)scene.models().size());
+    EXPECT_EQ(0,countMismatches(labelImage(detector,labels.rows,labels.cols),expected)) << "seed " << seed;
+  }
+}
+
+//the label image, the statistics and the ids don't depend on the configuration
+TEST_P(ObjectDetectorTest, DetectionsAreConsistent){
+  SyntheticScene scene;
+  scene.generate(7);
+  ObjectDetector detector;
+  configure(detector,scene);
+  detector.setImages(scene.rgbImage(),scene.depthImage());
+  detector.setCameraTransforms(scene.rgbdCameraTransform(),scene.logicalCameraTransform());
+  detector.setModels(scene.models());
+  detector.compute();
+
+  const DetectionVector &detections = detector.detections();
+  for(size_t j=0; j<detections.size(); ++j){
+    const Detection &detection = detections[j];
+    EXPECT_EQ(scene.models()[j].type(),detection.type());
+    EXPECT_EQ((int)j,detection.id());
+    int num_pixels = 0;
+    bool inside = true;
+    detection.forEachPixel([&](int r, int c){
+        ++num_pixels;
+        inside = inside && r >= detection.topLeft().x() && r <= detection.bottomRight().x() &&
+                 c >= detection.topLeft().y() && c <= detection.bottomRight().y();
+      });
+    EXPECT_EQ(num_pixels,detection.numPixels());
+    EXPECT_TRUE(inside);
+  }
+}
+
+namespace{
+
+  //statistics of the pixels given each label, computed from the depth image like the detector should
+  struct GroundTruthStatistics{
+    GroundTruthStatistics():num_pixels(0),r_sum(0),c_sum(0),depth_sum(0),
+                            min_point(Eigen::Vector3f::Constant(std::numeric_limits<float>::max())),
+                            max_point(Eigen::Vector3f::Constant(-std::numeric_limits<float>::max())){}
+    int num_pixels;
+    double r_sum;
+    double c_sum;
+    double depth_sum;
+    std::vector<float> depths;
+    Eigen::Vector3f min_point;
+    Eigen::Vector3f max_point;
+  };
+
+  std::vector<GroundTruthStatistics> groundTruthStatistics(const SyntheticScene &scene, const IntImage &labels){
+    const SyntheticScene::Parameters &parameters = scene.parameters();
+    std::vector<GroundTruthStatistics> statistics(scene.models().size());
+    const Eigen::Matrix3f inverse_K = scene.K().inverse();
+    for(int r=0; r<labels.rows; ++r)
+      for(int c=0; c<labels.cols; ++c){
+        const int label = labels(r,c);
+        if(label < 0)
+          continue;
+        GroundTruthStatistics &s = statistics[label];
+        ++s.num_pixels;
+        s.r_sum += r;
+        s.c_sum += c;
+        const float depth = 0.001f*scene.depthImage()(r,c);
+        if(depth < parameters.min_distance || depth > parameters.max_distance)
+          continue;
+        const Eigen::Vector3f point = inverse_K*Eigen::Vector3f(c,r,1)*depth;
+        s.depth_sum += depth;
+        s.depths.push_back(depth);
+        s.min_point = s.min_point.cwiseMin(point);
+        s.max_point = s.max_point.cwiseMax(point);
+      }
+    return statistics;
+  }
+
+}
+
+//statistics accumulated during the scan must be those of the pixels each detection should get
+TEST_P(ObjectDetectorTest, StatisticsMatchGroundTruth){
+  const Configuration &configuration = GetParam();
+  SyntheticScene scene;
+  scene.generate(9);
+  ObjectDetector detector;
+  configure(detector,scene);
+  detector.setImages(scene.rgbImage(),scene.depthImage());
+  detector.setCameraTransforms(scene.rgbdCameraTransform(),scene.logicalCameraTransform());
+  detector.setModels(scene.models());
+  detector.compute();
+
+  const IntImage expected = expectedLabels(scene.expectedLabels(),1 << configuration.pyramid_level,configuration.refine_boundaries);
+  std::vector<GroundTruthStatistics> statistics = groundTruthStatistics(scene,expected);
+  const DetectionVector &detections = detector.detections();
+  ASSERT_EQ(statistics.size(),detections.size());
+  int num_checked = 0;
+  for(size_t j=0; j<detections.size(); ++j){
+    const Detection &detection = detections[j];
+    GroundTruthStatistics &s = statistics[j];
+    ASSERT_EQ(s.num_pixels,detection.numPixels()) << "detection " << j;
+    if(!s.num_pixels)
+      continue;
+    EXPECT_NEAR(s.r_sum/s.num_pixels,detection.centroid().x(),1e-3) << "detection " << j;
+    EXPECT_NEAR(s.c_sum/s.num_pixels,detection.centroid().y(),1e-3) << "detection " << j;
+    if(s.depths.empty())
+      continue;
+    ++num_checked;
+    EXPECT_NEAR(s.depth_sum/s.depths.size(),detection.meanDepth(),1e-4) << "detection " << j;
+    //the median comes from a histogram with bins of 1 cm
+    std::nth_element(s.depths.begin(),s.depths.begin()+(s.depths.size()-1)/2,s.depths.end());
+    EXPECT_NEAR(s.depths[(s.depths.size()-1)/2],detection.medianDepth(),0.01) << "detection " << j;
+    for(int i=0; i<3; ++i){
+      EXPECT_NEAR(s.min_point[i],detection.minPoint()[i],1e-4) << "detection " << j;
+      EXPECT_NEAR(s.max_point[i],detection.maxPoint()[i],1e-4) << "detection " << j;
+    }
+  }
+  EXPECT_GT(num_checked,0);
+}
+
+//every labelled pixel with a valid depth gives one point, labelled with the id of its detection
+TEST_P(ObjectDetectorTest, CloudMatchesPixels){
+  SyntheticScene scene;
+  scene.generate(10);
+  ObjectDetector detector;
+  configure(detector,scene);
+  detector.setComputeCloud(true);
+  //a first frame with the models reversed, so that the ids aren't the detection indices
+  ModelVector models = scene.models();
+  std::reverse(models.begin(),models.end());
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),models);
+  const IntImage labels = computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  ASSERT_EQ((int)models.size()-1,detector.detections()[0].id());
+  const SyntheticScene::Parameters &parameters = scene.parameters();
+
+  int num_points = 0;
+  for(int r=0; r<labels.rows; ++r)
+    for(int c=0; c<labels.cols; ++c){
+      const float depth = 0.001f*scene.depthImage()(r,c);
+      num_points += (labels(r,c) >= 0 && depth >= parameters.min_distance && depth <= parameters.max_distance);
+    }
+  const ObjectDetector::LabeledCloud &cloud = detector.cloud();
+  ASSERT_EQ(num_points,(int)cloud.points.size());
+  EXPECT_EQ(cloud.points.size(),(size_t)cloud.width);
+  EXPECT_EQ(1u,cloud.height);
+
+  //points are found back from their projection
+  const Eigen::Matrix3f &K = scene.K();
+  const Eigen::Matrix3f inverse_K = K.inverse();
+  UnsignedCharImage seen(labels.rows,labels.cols);
+  seen = 0;
+  for(size_t i=0; i<cloud.points.size(); ++i){
+    const pcl::PointXYZL &point = cloud.points[i];
+    ASSERT_GT(point.z,0);
+    const int c = (int)std::floor(K(0,0)*point.x/point.z+K(0,2)+0.5);
+    const int r = (int)std::floor(K(1,1)*point.y/point.z+K(1,2)+0.5);
+    ASSERT_TRUE(r >= 0 && r < labels.rows && c >= 0 && c < labels.cols) << "point " << i;
+    EXPECT_FALSE(seen(r,c)) << "pixel " << r << "," << c;
+    seen(r,c) = 1;
+
+    const int label = labels(r,c);
+    ASSERT_GE(label,0) << "pixel " << r << "," << c;
+    EXPECT_EQ(detector.detections()[label].id(),(int)point.label) << "pixel " << r << "," << c;
+    const Eigen::Vector3f expected = inverse_K*Eigen::Vector3f(c,r,1)*(0.001f*scene.depthImage()(r,c));
+    EXPECT_NEAR(expected.x(),point.x,1e-4) << "pixel " << r << "," << c;
+    EXPECT_NEAR(expected.y(),point.y,1e-4) << "pixel " << r << "," << c;
+    EXPECT_NEAR(expected.z(),point.z,1e-4) << "pixel " << r << "," << c;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Engines, ObjectDetectorTest, ::testing::Values(
+  Configuration{ObjectDetector::BackProjectionEngine, 0, true,  ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::RasterizationEngine,  0, true,  ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::BackProjectionEngine, 0, true,  ObjectDetector::CompactPointFormat},
+  Configuration{ObjectDetector::RasterizationEngine,  0, true,  ObjectDetector::CompactPointFormat}));
+
+INSTANTIATE_TEST_CASE_P(PyramidLevels, ObjectDetectorTest, ::testing::Values(
+  Configuration{ObjectDetector::BackProjectionEngine, 1, false, ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::BackProjectionEngine, 1, true,  ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::BackProjectionEngine, 2, false, ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::BackProjectionEngine, 2, true,  ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::RasterizationEngine,  1, true,  ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::RasterizationEngine,  2, true,  ObjectDetector::Float3PointFormat},
+  Configuration{ObjectDetector::BackProjectionEngine, 1, false, ObjectDetector::CompactPointFormat},
+  Configuration{ObjectDetector::BackProjectionEngine, 1, true,  ObjectDetector::CompactPointFormat},
+  Configuration{ObjectDetector::RasterizationEngine,  2, true,  ObjectDetector::CompactPointFormat}));
+
+namespace{
+
+  //an incremental detector run over a sequence must give the labels of a full pass
+  class IncrementalTest : public ::testing::TestWithParam<ObjectDetector::PointFormat>{
+  protected:
+    void SetUp(){
+      configure(_detector);
+      configure(_reference);
+      _detector.setIncremental(true);
+    }
+
+    void configure(ObjectDetector &detector) const {
+      detector.setVerbose(false);
+      detector.setPointFormat(GetParam());
+    }
+
+    //computes the frame with both detectors, true if it was incremental
+    bool compute(const SyntheticScene &scene,
+                 const cv::Mat &depth_image,
+                 const Eigen::Isometry3f &rgbd_camera_transform,
+                 const ModelVector &models){
+      _detector.setK(scene.K());
+      _reference.setK(scene.K());
+      const IntImage labels = computeLabels(_detector,scene,depth_image,rgbd_camera_transform,models);
+      const IntImage expected = computeLabels(_reference,scene,depth_image,rgbd_camera_transform,models);
+      EXPECT_EQ(0,countMismatches(labels,expected));
+      return _detector.numRetestedPixels() >= 0;
+    }
+
+    bool compute(const SyntheticScene &scene){
+      return compute(scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    }
+
+    ObjectDetector _detector;
+    ObjectDetector _reference;
+  };
+
+}
+
+TEST_P(IncrementalTest, FollowsMovingModels){
+  SyntheticScene scene;
+  for(unsigned int seed=0; seed<2; ++seed){
+    for(int frame=0; frame<6; ++frame){
+      scene.generate(seed,frame);
+      const bool incremental = compute(scene);
+      EXPECT_EQ(frame > 0,incremental);
+      EXPECT_EQ(0,countMismatches(labelImage(_detector,scene.parameters().rows,scene.parameters().cols),scene.expectedLabels()))
+        << "seed " << seed << ", frame " << frame;
+    }
+    EXPECT_LT(_detector.numRetestedPixels(),scene.parameters().rows*scene.parameters().cols/2);
+  }
+}
+
+//a real sensor's noise changes in every frame, the labels must still be those of a full pass
+TEST_P(IncrementalTest, FollowsNoisyDepth){
+  SyntheticScene::Parameters parameters;
+  parameters.noise_per_frame = true;
+  SyntheticScene scene(parameters);
+  for(int frame=0; frame<4; ++frame){
+    scene.generate(1,frame);
+    EXPECT_EQ(frame > 0,compute(scene));
+    EXPECT_EQ(0,countMismatches(labelImage(_detector,parameters.rows,parameters.cols),scene.expectedLabels()))
+      << "frame " << frame;
+  }
+  EXPECT_LT(_detector.numRetestedPixels(),parameters.rows*parameters.cols/4);
+}
+
+TEST_P(IncrementalTest, LabelsFilledHoles){
+  SyntheticScene scene;
+  scene.generate(3);
+  RawDepthImage depth_image = scene.depthImage().clone();
+  for(int r=100; r<300; ++r)
+    for(int c=0; c<depth_image.cols; ++c)
+      depth_image(r,c) = 0;
+  compute(scene,depth_image,scene.rgbdCameraTransform(),scene.models());
+  EXPECT_TRUE(compute(scene));
+  EXPECT_EQ(0,countMismatches(labelImage(_detector,depth_image.rows,depth_image.cols),scene.expectedLabels()));
+}
+
+//static models whose box moves anyway, with a camera that moved or models that changed order;
+//only the band around the box faces is tested again, unless a box moved too far in the image
+//or the boxes deciding a label may have changed
+TEST_P(IncrementalTest, FollowsBoxChanges){
+  SyntheticScene scene;
+  scene.generate(4);
+  const int num_pixels = scene.parameters().rows*scene.parameters().cols;
+  EXPECT_FALSE(compute(scene));
+  EXPECT_TRUE(compute(scene));
+  EXPECT_LT(_detector.numRetestedPixels(),num_pixels/1000);
+
+  Eigen::Isometry3f rgbd_camera_transform = scene.rgbdCameraTransform();
+  rgbd_camera_transform.translation().z() += 0.005f;
+  EXPECT_TRUE(compute(scene,scene.depthImage(),rgbd_camera_transform,scene.models()));
+  EXPECT_LT(_detector.numRetestedPixels(),num_pixels/4);
+  rgbd_camera_transform.translation().z() += 0.2f;
+  EXPECT_FALSE(compute(scene,scene.depthImage(),rgbd_camera_transform,scene.models()));
+  EXPECT_TRUE(compute(scene,scene.depthImage(),rgbd_camera_transform,scene.models()));
+
+  ModelVector models = scene.models();
+  std::reverse(models.begin(),models.end());
+  EXPECT_FALSE(compute(scene,scene.depthImage(),rgbd_camera_transform,models));
+  models.erase(models.begin()+3);
+  EXPECT_TRUE(compute(scene,scene.depthImage(),rgbd_camera_transform,models));
+  models[0].pose().translation().z() += 0.005f;
+  EXPECT_TRUE(compute(scene,scene.depthImage(),rgbd_camera_transform,models));
+  models[0].pose().translation().z() += 0.3f;
+  EXPECT_FALSE(compute(scene,scene.depthImage(),rgbd_camera_transform,models));
+  models.push_back(scene.models()[0]);
+  EXPECT_FALSE(compute(scene,scene.depthImage(),rgbd_camera_transform,models));
+}
+
+INSTANTIATE_TEST_CASE_P(PointFormats, IncrementalTest, ::testing::Values(
+  ObjectDetector::Float3PointFormat,
+  ObjectDetector::CompactPointFormat));
+
+//publishing moves the results to the snapshot: the accessors and the snapshot must show
+//the frame a non-publishing detector computes, and pinned snapshots must not change
+TEST(SnapshotTest, HoldsTheResultsOfItsFrame){
+  SyntheticScene scene;
+  ObjectDetector detector, reference;
+  detector.setVerbose(false);
+  reference.setVerbose(false);
+  detector.setPublishSnapshots(true);
+
+  ObjectDetector::SnapshotHandle first;
+  IntImage first_labels;
+  for(int frame=0; frame<6; ++frame){
+    scene.generate(5,frame);
+    detector.setK(scene.K());
+    reference.setK(scene.K());
+    const IntImage labels = computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    const IntImage expected = computeLabels(reference,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    EXPECT_EQ(0,countMismatches(labels,expected)) << "frame " << frame;
+    EXPECT_TRUE(equal(detector.labelImage(),reference.labelImage())) << "frame " << frame;
+
+    const ObjectDetector::SnapshotHandle snapshot = detector.snapshot();
+    ASSERT_TRUE(snapshot.valid());
+    EXPECT_EQ((unsigned long)frame+1,snapshot->frame);
+    EXPECT_EQ(&detector.detections(),&snapshot->detections);
+    EXPECT_EQ(&detector.boundingBoxes(),&snapshot->bounding_boxes);
+    EXPECT_EQ(&detector.labelImage(),&snapshot->label_image);
+    ASSERT_EQ(reference.boundingBoxes().size(),snapshot->bounding_boxes.size());
+    for(size_t j=0; j<snapshot->bounding_boxes.size(); ++j){
+      EXPECT_EQ(reference.boundingBoxes()[j].first,snapshot->bounding_boxes[j].first);
+      EXPECT_EQ(reference.boundingBoxes()[j].second,snapshot->bounding_boxes[j].second);
+    }
+    if(!frame){
+      first = snapshot;
+      first_labels = labels;
+    }
+  }
+
+  //computing frames 1 to 5 must not have touched frame 0
+  ASSERT_EQ(scene.models().size(),first->detections.size());
+  IntImage labels(first_labels.rows,first_labels.cols);
+  labels = -1;
+  for(int j=0; j<(int)first->detections.size(); ++j)
+    first->detections[j].forEachPixel([&labels,j](int r, int c){labels(r,c) = j;});
+  EXPECT_EQ(0,countMismatches(labels,first_labels));
+}
+
+namespace{
+
+  void expectSameBoxes(const ObjectDetector &detector, const ObjectDetector &reference){
+    ASSERT_EQ(reference.boundingBoxes().size(),detector.boundingBoxes().size());
+    for(size_t j=0; j<detector.boundingBoxes().size(); ++j){
+      EXPECT_EQ(reference.boundingBoxes()[j].first,detector.boundingBoxes()[j].first) << "box " << j;
+      EXPECT_EQ(reference.boundingBoxes()[j].second,detector.boundingBoxes()[j].second) << "box " << j;
+    }
+  }
+
+}
+
+//models that didn't move reuse their box, the others, and all of them when a camera
+//moves, compute it again; cached boxes must be those a fresh detector computes
+TEST(ModelCacheTest, ReusesTheBoxesOfStaticModels){
+  SyntheticScene scene;
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  const int num_models = scene.parameters().num_models;
+
+  scene.generate(6,0);
+  detector.setK(scene.K());
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_EQ(0ul,detector.numModelHits());
+  EXPECT_EQ((unsigned long)num_models,detector.numModelMisses());
+  EXPECT_EQ((size_t)num_models,detector.modelTable().size());
+
+  //odd models move every frame
+  for(int frame=1; frame<4; ++frame){
+    scene.generate(6,frame);
+    computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    EXPECT_EQ((unsigned long)frame*num_models/2,detector.numModelHits()) << "frame " << frame;
+    EXPECT_EQ((unsigned long)num_models+frame*num_models/2,detector.numModelMisses()) << "frame " << frame;
+
+    ObjectDetector reference;
+    reference.setVerbose(false);
+    reference.setK(scene.K());
+    computeLabels(reference,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    expectSameBoxes(detector,reference);
+  }
+
+  //a moving camera invalidates every box
+  unsigned long num_hits = detector.numModelHits();
+  unsigned long num_misses = detector.numModelMisses();
+  Eigen::Isometry3f rgbd_camera_transform = scene.rgbdCameraTransform();
+  rgbd_camera_transform.translation().x() += 0.1f;
+  computeLabels(detector,scene,scene.depthImage(),rgbd_camera_transform,scene.models());
+  EXPECT_EQ(num_hits,detector.numModelHits());
+  EXPECT_EQ(num_misses+num_models,detector.numModelMisses());
+
+  //a model missing from a frame leaves the table, and misses when it comes back
+  ModelVector models = scene.models();
+  models.erase(models.begin());
+  num_hits = detector.numModelHits();
+  num_misses = detector.numModelMisses();
+  computeLabels(detector,scene,scene.depthImage(),rgbd_camera_transform,models);
+  EXPECT_EQ(num_hits+num_models-1,detector.numModelHits());
+  EXPECT_EQ(num_misses,detector.numModelMisses());
+  EXPECT_EQ((size_t)num_models-1,detector.modelTable().size());
+  EXPECT_EQ(0u,detector.modelTable().count(scene.models()[0].type()));
+
+  computeLabels(detector,scene,scene.depthImage(),rgbd_camera_transform,scene.models());
+  EXPECT_EQ(num_hits+2*(num_models-1),detector.numModelHits());
+  EXPECT_EQ(num_misses+1,detector.numModelMisses());
+}
+
+//names keep their id across short absences and lose it after the lifetime; ids aren't reused
+TEST(InstanceIdTest, ExpireAfterTheirLifetime){
+  SyntheticScene scene;
+  scene.generate(6);
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  detector.setK(scene.K());
+  detector.setInstanceIdLifetime(2);
+  const int num_models = scene.parameters().num_models;
+  const std::string &type = scene.models()[0].type();
+
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  ASSERT_EQ((size_t)num_models,detector.instanceIds().size());
+  const int id = detector.instanceIds().at(type).id;
+  EXPECT_EQ(id,detector.detections()[0].id());
+
+  ModelVector models = scene.models();
+  models.erase(models.begin());
+  for(int frame=0; frame<2; ++frame)
+    computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),models);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_EQ(id,detector.detections()[0].id());
+
+  for(int frame=0; frame<3; ++frame)
+    computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),models);
+  EXPECT_EQ((size_t)num_models-1,detector.instanceIds().size());
+  EXPECT_EQ(0u,detector.instanceIds().count(type));
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_EQ(num_models,detector.detections()[0].id());
+
+  detector.resetInstanceIds();
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_EQ((size_t)num_models,detector.instanceIds().size());
+  for(int i=0; i<num_models; ++i)
+    EXPECT_LT(detector.detections()[i].id(),num_models);
+}
+
+namespace{
+
+  size_t bufferMemory(const ObjectDetector::MemoryReport &report, const std::string &name){
+    for(size_t i=0; i<report.size(); ++i)
+      if(report[i].name == name)
+        return report[i].bytes;
+    ADD_FAILURE() << "no buffer named " << name;
+    return 0;
+  }
+
+}
+
+TEST(MemoryTest, ReportsEveryBuffer){
+  SyntheticScene scene;
+  scene.generate(8);
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  detector.setK(scene.K());
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+
+  const ObjectDetector::MemoryReport report = detector.memoryReport();
+  size_t total = 0;
+  for(size_t i=0; i<report.size(); ++i){
+    total += report[i].bytes;
+    for(size_t k=0; k<i; ++k)
+      EXPECT_NE(report[k].name,report[i].name);
+  }
+  EXPECT_EQ(total,detector.memoryUsage());
+
+  const size_t num_pixels = scene.parameters().rows*scene.parameters().cols;
+  EXPECT_EQ(3*num_pixels,bufferMemory(report,"rgb_image"));
+  EXPECT_EQ(65536*sizeof(float),bufferMemory(report,"depth_lut"));
+  EXPECT_EQ(12*num_pixels,bufferMemory(report,"directions_image"));
+  EXPECT_EQ(12*num_pixels,bufferMemory(report,"points_image"));
+  EXPECT_EQ(3*num_pixels,bufferMemory(report,"label_image"));
+  //full resolution reads the raw depth through the LUT
+  EXPECT_EQ(0u,bufferMemory(report,"depth_image"));
+  EXPECT_EQ(0u,bufferMemory(report,"raw_depth_image"));
+  EXPECT_GT(bufferMemory(report,"detection_pixels"),0u);
+}
+
+//bounded memory releases what the configuration doesn't read, even buffers an earlier
+//configuration left behind, without changing the labels
+TEST(MemoryTest, BoundedMemoryReleasesUnusedBuffers){
+  SyntheticScene scene;
+  scene.generate(8);
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  detector.setK(scene.K());
+  detector.setEngine(ObjectDetector::RasterizationEngine);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  detector.setIncremental(true);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  const size_t unbounded_memory = detector.memoryUsage();
+  EXPECT_GT(bufferMemory(detector.memoryReport(),"id_image"),0u);
+  EXPECT_GT(bufferMemory(detector.memoryReport(),"previous_labels"),0u);
+
+  detector.setEngine(ObjectDetector::BackProjectionEngine);
+  detector.setIncremental(false);
+  detector.setPointFormat(ObjectDetector::CompactPointFormat);
+  detector.setBoundedMemory(true);
+  const IntImage labels = computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_EQ(0,countMismatches(labels,scene.expectedLabels()));
+
+  const ObjectDetector::MemoryReport report = detector.memoryReport();
+  const char* released[] = {"rgb_image","depth_image","directions_image","points_image","id_image",
+                            "previous_labels","previous_depths"};
+  for(size_t i=0; i<sizeof(released)/sizeof(released[0]); ++i)
+    EXPECT_EQ(0u,bufferMemory(report,released[i])) << released[i];
+  const size_t num_pixels = scene.parameters().rows*scene.parameters().cols;
+  EXPECT_EQ(2*num_pixels,bufferMemory(report,"raw_depth_image"));
+  EXPECT_EQ(8*num_pixels,bufferMemory(report,"rays_image"));
+  EXPECT_LT(detector.memoryUsage(),unbounded_memory);
+}
+
+//detections over the cap move their pixels to a mask, which holds the same pixels
+TEST(MemoryTest, CapsDetectionPixels){
+  SyntheticScene scene;
+  scene.generate(8);
+  ObjectDetector detector, reference;
+  detector.setVerbose(false);
+  reference.setVerbose(false);
+  detector.setK(scene.K());
+  reference.setK(scene.K());
+  const int max_detection_pixels = 1000;
+  detector.setBoundedMemory(true);
+  detector.setMaxDetectionPixels(max_detection_pixels);
+  const IntImage labels = computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  computeLabels(reference,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_EQ(0,countMismatches(labels,scene.expectedLabels()));
+
+  int num_masks = 0;
+  const DetectionVector &detections = detector.detections();
+  ASSERT_EQ(reference.detections().size(),detections.size());
+  for(size_t j=0; j<detections.size(); ++j){
+    const Detection &detection = detections[j];
+    EXPECT_EQ(reference.detections()[j].numPixels(),detection.numPixels());
+    EXPECT_EQ(detection.numPixels() > max_detection_pixels,detection.hasMask()) << "detection " << j;
+    if(detection.hasMask()){
+      ++num_masks;
+      EXPECT_TRUE(detection.pixels().empty());
+      EXPECT_EQ(detection.maskRows()*detection.maskCols(),(int)detection.mask().size());
+    } else {
+      EXPECT_EQ(detection.numPixels(),(int)detection.pixels().size());
+    }
+  }
+  EXPECT_GT(num_masks,0);
+  EXPECT_LT(bufferMemory(detector.memoryReport(),"detection_pixels"),
+            bufferMemory(reference.memoryReport(),"detection_pixels"));
+}
+
+//bounded memory gives back what an earlier configuration grew once, then reuses the buffers
+//of the previous frames; the cloud is reserved for its cap and holds no more points
+TEST(MemoryTest, ReusesBoundedBuffersAcrossFrames){
+  SyntheticScene scene;
+  scene.generate(8);
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  detector.setK(scene.K());
+  detector.setComputeCloud(true);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  const size_t unbounded_pixels = bufferMemory(detector.memoryReport(),"detection_pixels");
+  const size_t unbounded_cloud = bufferMemory(detector.memoryReport(),"cloud");
+
+  const int max_cloud_points = 5000;
+  detector.setBoundedMemory(true);
+  detector.setMaxDetectionPixels(1000);
+  detector.setMaxCloudPoints(max_cloud_points);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  const ObjectDetector::MemoryReport report = detector.memoryReport();
+  EXPECT_LT(bufferMemory(report,"detection_pixels"),unbounded_pixels);
+  EXPECT_EQ(max_cloud_points*sizeof(pcl::PointXYZL),bufferMemory(report,"cloud"));
+  EXPECT_LT(bufferMemory(report,"cloud"),unbounded_cloud);
+  EXPECT_EQ((size_t)max_cloud_points,detector.cloud().points.size());
+
+  for(int frame=0; frame<2; ++frame){
+    computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    EXPECT_EQ(bufferMemory(report,"detection_pixels"),bufferMemory(detector.memoryReport(),"detection_pixels"));
+    EXPECT_EQ(bufferMemory(report,"cloud"),bufferMemory(detector.memoryReport(),"cloud"));
+  }
+}
+
+namespace{
+
+  class FixedSizeCoreTest : public ::testing::TestWithParam<ObjectDetector::PointFormat>{
+  protected:
+    void configure(ObjectDetector &detector, const SyntheticScene &scene) const {
+      detector.setVerbose(false);
+      detector.setPointFormat(GetParam());
+      detector.setK(scene.K());
+    }
+  };
+
+}
+
+//the compile-time sized core gives the tiles and the labels of the dynamic one
+TEST_P(FixedSizeCoreTest, MatchesTheDynamicCore){
+  SyntheticScene scene;
+  for(unsigned int seed=0; seed<3; ++seed){
+    scene.generate(seed);
+    ObjectDetector detector, reference;
+    configure(detector,scene);
+    configure(reference,scene);
+    ASSERT_TRUE(detector.setSensorResolution(scene.parameters().rows,scene.parameters().cols));
+    const IntImage labels = computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    const IntImage reference_labels = computeLabels(reference,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+    EXPECT_TRUE(detector.fixedSizeFrame());
+    EXPECT_FALSE(reference.fixedSizeFrame());
+    EXPECT_EQ(0,countMismatches(labels,reference_labels)) << "seed " << seed;
+    EXPECT_EQ(0,countMismatches(labels,scene.expectedLabels())) << "seed " << seed;
+
+    const ImageTileVector &tiles = detector.tiles();
+    const ImageTileVector &reference_tiles = reference.tiles();
+    ASSERT_EQ(reference_tiles.size(),tiles.size());
+    ASSERT_EQ(reference.tileStatistics().size(),detector.tileStatistics().size());
+    for(size_t t=0; t<tiles.size(); ++t){
+      EXPECT_EQ(reference_tiles[t].r_max,tiles[t].r_max) << "tile " << t;
+      EXPECT_EQ(reference_tiles[t].c_max,tiles[t].c_max) << "tile " << t;
+      EXPECT_EQ(reference_tiles[t].num_valid,tiles[t].num_valid) << "tile " << t;
+      EXPECT_EQ(reference_tiles[t].min,tiles[t].min) << "tile " << t;
+      EXPECT_EQ(reference_tiles[t].max,tiles[t].max) << "tile " << t;
+      EXPECT_EQ(reference.tileStatistics()[t].num_candidates,detector.tileStatistics()[t].num_candidates) << "tile " << t;
+      EXPECT_EQ(reference.tileStatistics()[t].num_hits,detector.tileStatistics()[t].num_hits) << "tile " << t;
+    }
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(PointFormats, FixedSizeCoreTest, ::testing::Values(
+  ObjectDetector::Float3PointFormat,
+  ObjectDetector::CompactPointFormat));
+
+//frames the core wasn't compiled for fall back to the dynamic one
+TEST(FixedSizeCoreSelectionTest, OnlyRunsOnSensorSizedTiles){
+  SyntheticScene scene;
+  scene.generate(4);
+  ObjectDetector detector;
+  detector.setVerbose(false);
+  detector.setK(scene.K());
+  EXPECT_FALSE(detector.setSensorResolution(240,320));
+  EXPECT_FALSE(detector.fixedSizeCore());
+  ASSERT_TRUE(detector.setSensorResolution(scene.parameters().rows,scene.parameters().cols));
+  EXPECT_TRUE(detector.fixedSizeCore());
+
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_TRUE(detector.fixedSizeFrame());
+
+  detector.setPyramidLevel(1);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_FALSE(detector.fixedSizeFrame());
+  detector.setPyramidLevel(0);
+
+  detector.setTileSize(16);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_FALSE(detector.fixedSizeFrame());
+  detector.setTileSize(32);
+
+  detector.setEngine(ObjectDetector::RasterizationEngine);
+  computeLabels(detector,scene,scene.depthImage(),scene.rgbdCameraTransform(),scene.models());
+  EXPECT_FALSE(detector.fixedSizeFrame());
+}
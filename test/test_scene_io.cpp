@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <lucrezio_semantic_perception/scene_io.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  const char* kTransform = "0 0 0.5 1 0 0 0 1 0 0 0 1\n";
+  const char* kModel = "table_1 1 2 3 1 0 0 0 1 0 0 0 1 -0.5 -0.5 -0.5 0.5 0.5 0.5\n";
+
+  std::string scene(const std::string &count, int num_model_lines){
+    std::string text = std::string(kTransform)+kTransform+count+"\n";
+    for(int i=0; i<num_model_lines; ++i)
+      text += kModel;
+    return text;
+  }
+
+  class SceneParserTest : public ::testing::Test{
+  protected:
+    bool parse(const std::string &text){
+      return _parser.parse(text.data(),text.data()+text.size(),_rgbd_camera_transform,_logical_camera_transform,_models);
+    }
+
+    SceneParser _parser;
+    Eigen::Isometry3f _rgbd_camera_transform;
+    Eigen::Isometry3f _logical_camera_transform;
+    ModelVector _models;
+  };
+
+}
+
+TEST_F(SceneParserTest, ReadsBackWrittenScene){
+  ModelVector models;
+  Eigen::Isometry3f pose = Eigen::Isometry3f::Identity();
+  pose.translation() = Eigen::Vector3f(0.1f,-2.25f,3.0f/7);
+  pose.linear() = Eigen::AngleAxisf(0.3f,Eigen::Vector3f(1,2,3).normalized()).toRotationMatrix();
+  models.push_back(Model("table_1",pose,Eigen::Vector3f(-1,-2,-3),Eigen::Vector3f(1,2,3)));
+  models.push_back(Model("salt_2",pose.inverse(),Eigen::Vector3f::Constant(-1e-3f),Eigen::Vector3f::Constant(1.0f/3)));
+
+  std::ostringstream stream;
+  writeScene(stream,pose,pose.inverse(),models);
+  ASSERT_TRUE(parse(stream.str())) << _parser.error();
+
+  EXPECT_TRUE(_rgbd_camera_transform.matrix() == pose.matrix());
+  EXPECT_TRUE(_logical_camera_transform.matrix() == pose.inverse().matrix());
+  ASSERT_EQ(models.size(),_models.size());
+  for(size_t i=0; i<models.size(); ++i){
+    EXPECT_EQ(models[i].type(),_models[i].type());
+    EXPECT_TRUE(models[i].pose().matrix() == _models[i].pose().matrix());
+    EXPECT_TRUE(models[i].min() == _models[i].min());
+    EXPECT_TRUE(models[i].max() == _models[i].max());
+  }
+}
+
+TEST_F(SceneParserTest, AcceptsCountAndModels){
+  EXPECT_TRUE(parse(scene("0",0))) << _parser.error();
+  EXPECT_TRUE(_models.empty());
+  EXPECT_TRUE(parse(scene("3",3))) << _parser.error();
+  EXPECT_EQ(3u,_models.size());
+  //the last line may lack its newline
+  std::string text = scene("2",2);
+  text.resize(text.size()-1);
+  EXPECT_TRUE(parse(text)) << _parser.error();
+  EXPECT_EQ(2u,_models.size());
+}
+
+TEST_F(SceneParserTest, RejectsMalformedCounts){
+  const char* counts[] = {"2e9","3e9","1e1","1.5","3.0","-1","+1","x","99999999999999999999","2147483648"};
+  for(size_t i=0; i<sizeof(counts)/sizeof(counts[0]); ++i){
+    EXPECT_FALSE(parse(scene(counts[i],3))) << counts[i];
+    EXPECT_FALSE(_parser.error().empty());
+  }
+}
+
+TEST_F(SceneParserTest, RejectsCountBeyondLinesLeft){
+  EXPECT_FALSE(parse(scene("4",3)));
+  EXPECT_FALSE(parse(scene("2000000000",3)));
+  EXPECT_FALSE(parse(scene("1",0)));
+}
+
+TEST_F(SceneParserTest, FailureLeavesOutputsUntouched){
+  ASSERT_TRUE(parse(scene("2",2))) << _parser.error();
+  EXPECT_FALSE(parse(scene("2",1)+"salt_2 1 2\n"));
+  EXPECT_EQ(2u,_models.size());
+  EXPECT_FALSE(parse(std::string(kTransform)));
+  EXPECT_FALSE(parse(""));
+  EXPECT_EQ(2u,_models.size());
+}
+
+TEST_F(SceneParserTest, ReportsFilesItCannotOpen){
+  const std::string filename = "/nonexistent/scene.txt";
+  EXPECT_FALSE(_parser.read(filename,_rgbd_camera_transform,_logical_camera_transform,_models));
+  EXPECT_EQ(filename+": "+std::strerror(ENOENT),_parser.error());
+}
+
+TEST_F(SceneParserTest, ReportsTheFileOfAParseError){
+  const std::string filename = testing::TempDir()+"scene_parser_test.txt";
+  {
+    std::ofstream stream(filename.c_str());
+    stream << scene("2",1);
+  }
+  EXPECT_FALSE(_parser.read(filename,_rgbd_camera_transform,_logical_camera_transform,_models));
+  EXPECT_EQ(0u,_parser.error().find(filename+": line "));
+  std::remove(filename.c_str());
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include <lucrezio_semantic_perception/worker_pool.h>
+
+using namespace lucrezio_semantic_perception;
+
+namespace{
+
+  //a detector instance that always has a frame waiting: every run submits the next one,
+  //like ObjectDetectorNode::processFrame does with its pending frame
+  class BusyInstance{
+  public:
+    BusyInstance(WorkerPool &pool_, std::atomic<int> &budget_):
+      _pool(pool_),
+      _budget(budget_),
+      _num_runs(0){}
+
+    void start(){_pool.submit(std::bind(&BusyInstance::run,this));}
+
+    inline int numRuns() const {return _num_runs;}
+
+  private:
+    WorkerPool &_pool;
+    std::atomic<int> &_budget;
+    std::atomic<int> _num_runs;
+
+    void run(){
+      if(--_budget < 0)
+        return;
+      ++_num_runs;
+      const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now()+std::chrono::microseconds(100);
+      while(std::chrono::steady_clock::now() < end);
+      _pool.submit(std::bind(&BusyInstance::run,this));
+    }
+  };
+
+  void runInstances(int num_threads, int num_instances, int num_runs, std::vector<int> &runs){
+    std::atomic<int> budget(num_runs);
+    std::vector<std::unique_ptr<BusyInstance> > instances;
+    {
+      WorkerPool pool(num_threads,16);
+      //the threads wait until every instance has its first frame queued
+      std::atomic<bool> started(false);
+      for(int i=0; i<num_threads; ++i)
+        pool.submit([&started]{while(!started) std::this_thread::yield();});
+      for(int i=0; i<num_instances; ++i)
+        instances.push_back(std::unique_ptr<BusyInstance>(new BusyInstance(pool,budget)));
+      for(int i=0; i<num_instances; ++i)
+        instances[i]->start();
+      started = true;
+      while(budget > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    runs.clear();
+    for(int i=0; i<num_instances; ++i)
+      runs.push_back(instances[i]->numRuns());
+  }
+
+}
+
+TEST(WorkerPoolTest, RunsEveryTask){
+  std::atomic<int> num_runs(0);
+  int num_accepted = 0;
+  {
+    WorkerPool pool(4,1000);
+    for(int i=0; i<5000; ++i){
+      if(pool.submit([&num_runs]{++num_runs;}))
+        ++num_accepted;
+      else
+        std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(num_accepted,num_runs.load());
+}
+
+TEST(WorkerPoolTest, RejectsBeyondBound){
+  std::atomic<bool> release(false);
+  WorkerPool pool(1,2);
+  //the first task keeps the thread busy, the next two fill the queue
+  ASSERT_TRUE(pool.submit([&release]{while(!release) std::this_thread::yield();}));
+  while(pool.numExecuted() == 0 && !pool.submit([]{})){
+    std::this_thread::yield();
+  }
+  int num_accepted = 0;
+  for(int i=0; i<10; ++i)
+    num_accepted += pool.submit([]{});
+  EXPECT_LE(num_accepted,2);
+  EXPECT_GT(pool.numRejected(),0ul);
+  release = true;
+}
+
+//a task that throws is counted, and the thread goes on with the others
+TEST(WorkerPoolTest, CountsFailedTasks){
+  std::atomic<int> num_runs(0);
+  WorkerPool pool(1,16);
+  ASSERT_TRUE(pool.submit([]{throw std::runtime_error("failed task");}));
+  for(int i=0; i<4; ++i)
+    ASSERT_TRUE(pool.submit([&num_runs]{++num_runs;}));
+  while(pool.numExecuted() < 5)
+    std::this_thread::yield();
+  EXPECT_EQ(4,num_runs.load());
+  EXPECT_EQ(1ul,pool.numFailed());
+}
+
+//one thread: the instances must take turns
+TEST(WorkerPoolTest, BusyInstancesDontStarveEachOtherOnOneThread){
+  std::vector<int> runs;
+  runInstances(1,2,200,runs);
+  EXPECT_LE(std::abs(runs[0]-runs[1]),1) << runs[0] << " vs " << runs[1];
+}
+
+TEST(WorkerPoolTest, BusyInstancesDontStarveEachOther){
+  std::vector<int> runs;
+  runInstances(2,3,600,runs);
+  for(size_t i=0; i<runs.size(); ++i)
+    EXPECT_GE(runs[i],600/3/2) << "instance " << i << " ran " << runs[i] << " times";
+}